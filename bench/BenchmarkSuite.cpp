@@ -0,0 +1,251 @@
+#include "BenchmarkSuite.h"
+#include "core/Config.h"
+#include "grid/Grid.h"
+#include "grid/NormalCell.h"
+#include "grid/BorderCell.h"
+#include "grid/ParallelCell.h"
+#include "mesh/Mesh.h"
+#include "mesh/MeshParser.h"
+#include "mesh/MeshGenerator.h"
+#include "integral/ci.hpp"
+#include "integral/ci_impl.hpp"
+#include "utilities/Parallel.h"
+
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+BenchmarkSuite::BenchmarkSuite(Options options) : _options(std::move(options)), _grid(nullptr) {}
+
+void BenchmarkSuite::init() {
+    boost::property_tree::ptree root;
+
+    boost::property_tree::ptree gases, pressure, temperature;
+    for (unsigned int gi = 0; gi < _options.gasesSize; gi++) {
+        boost::property_tree::ptree gas;
+        gas.put("mass", 133.0);
+        gas.put("radius", 216.0);
+        gases.push_back(std::make_pair("", gas));
+
+        boost::property_tree::ptree value;
+        value.put("", 1.0);
+        pressure.push_back(std::make_pair("", value));
+        value.put("", 300.0);
+        temperature.push_back(std::make_pair("", value));
+    }
+    root.add_child("gases", gases);
+
+    boost::property_tree::ptree initial, param;
+    param.put("group", "Main");
+    param.add_child("pressure", pressure);
+    param.add_child("temperature", temperature);
+    initial.push_back(std::make_pair("", param));
+    root.add_child("initial", initial);
+
+    // all border groups of generated meshes are diffuse walls
+    boost::property_tree::ptree boundary;
+    for (const auto& group : {"Border", "BorderInlet", "BorderOutlet", "BorderWall"}) {
+        boost::property_tree::ptree borderParam, type;
+        borderParam.put("group", group);
+        for (unsigned int gi = 0; gi < _options.gasesSize; gi++) {
+            boost::property_tree::ptree value;
+            value.put("", "Diffuse");
+            type.push_back(std::make_pair("", value));
+        }
+        borderParam.add_child("type", type);
+        borderParam.add_child("temperature", temperature);
+        boundary.push_back(std::make_pair("", borderParam));
+    }
+    root.add_child("boundary", boundary);
+
+    root.put("impulse_sphere.max_impulse", _options.maxImpulse);
+    root.put("impulse_sphere.resolution", _options.resolution);
+
+    auto config = Config::getInstance();
+    config->load(root);
+    config->init();
+
+    // each rank builds the whole mesh itself, no need to send it
+    Mesh* mesh = nullptr;
+    if (MeshGenerator::isGeneratorSpec(_options.mesh)) {
+        mesh = MeshGenerator::generate(_options.mesh, 1.0);
+    } else {
+        mesh = MeshParser::getInstance().loadMesh(_options.mesh, 1.0);
+    }
+    mesh->init();
+
+    _grid = new Grid(mesh);
+    _grid->init();
+
+    ci::Potential* potential = new ci::HSPotential;
+    ci::init(potential, ci::NO_SYMM);
+}
+
+void BenchmarkSuite::run() {
+    auto config = Config::getInstance();
+    auto impulseSphere = config->getImpulseSphere();
+    double impulsesSize = impulseSphere->getImpulses().size();
+    double gasesSize = config->getGases().size();
+    const auto& normalCells = _grid->getNormalCells();
+    const auto& borderCells = _grid->getBorderCells();
+
+    double connectionsSize = 0.0;
+    for (auto cell : normalCells) {
+        connectionsSize += cell->getConnections().size();
+    }
+
+    // own values, each neighbor values and new values
+    measure("normal_transfer", "cell_impulse", normalCells.size() * impulsesSize * gasesSize,
+            (connectionsSize + 2 * normalCells.size()) * impulsesSize * gasesSize * sizeof(double), [&] {
+        for (auto cell : normalCells) {
+            cell->computeTransfer();
+        }
+    });
+
+    measure("border_diffuse", "cell_impulse", borderCells.size() * impulsesSize * gasesSize,
+            2 * borderCells.size() * impulsesSize * gasesSize * sizeof(double), [&] {
+        for (auto cell : borderCells) {
+            cell->computeTransfer();
+        }
+    });
+
+    // all results go from one pass of raw moments
+    measure("moments", "cell_impulse", normalCells.size() * impulsesSize * gasesSize,
+            normalCells.size() * impulsesSize * gasesSize * sizeof(double), [&] {
+        for (auto cell : normalCells) {
+            cell->getResults();
+        }
+    });
+
+    const auto& gases = config->getGases();
+    ci::Particle particle{};
+    particle.d = gases[0].getRadius();
+    auto generate = [&] {
+        ci::gen(config->getTimestep(), 50000,
+                impulseSphere->getResolution() / 2, impulseSphere->getResolution() / 2,
+                impulseSphere->getXYZ2I(), impulseSphere->getXYZ2I(),
+                impulseSphere->getDeltaImpulse(),
+                gases[0].getMass(), gases[0].getMass(),
+                particle, particle);
+    };
+    measure("ci_gen", "korobov_node", 50000, 0.0, generate);
+
+    // each collision node reads and writes four values
+    if (isSelected("ci_iter")) {
+        generate();
+    }
+    measure("ci_iter", "cell_impulse", normalCells.size() * impulsesSize,
+            normalCells.size() * ci::nc.size() * 8.0 * sizeof(double), [&] {
+        for (auto cell : normalCells) {
+            cell->computeIntegral(0, 0);
+        }
+    });
+
+    if (Parallel::isSingle() == false) {
+        double parallelSize = _grid->getParallelCells().size();
+        measure("sync", "cell_impulse", parallelSize * impulsesSize * gasesSize,
+                parallelSize * impulsesSize * gasesSize * sizeof(double), [&] {
+            _grid->sync();
+        });
+    }
+}
+
+void BenchmarkSuite::write() const {
+    if (Parallel::isMaster() == false) {
+        return;
+    }
+
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(18) << "benchmark"
+              << std::right << std::setw(14) << "items"
+              << std::setw(12) << "min ms"
+              << std::setw(12) << "mean ms"
+              << std::setw(12) << "ns/item"
+              << std::setw(10) << "GB/s" << std::endl;
+    for (const auto& result : _results) {
+        std::cout << std::left << std::setw(18) << result.name
+                  << std::right << std::setw(14) << std::setprecision(0) << std::fixed << result.items
+                  << std::setprecision(3)
+                  << std::setw(12) << result.minSeconds * 1e3
+                  << std::setw(12) << result.meanSeconds * 1e3
+                  << std::setw(12) << result.minSeconds * 1e9 / result.items
+                  << std::setw(10) << result.bytes / result.minSeconds * 1e-9 << std::endl;
+    }
+
+    std::ofstream fs(_options.output, std::ios::out | std::ios::trunc);
+    if (fs.is_open() == false) {
+        throw std::runtime_error("can't open benchmark output: " + _options.output);
+    }
+    fs << std::setprecision(6);
+    fs << "{" << std::endl;
+    fs << "  \"ranks\": " << Parallel::getSize() << "," << std::endl;
+    fs << "  \"mesh\": \"" << _options.mesh << "\"," << std::endl;
+    fs << "  \"resolution\": " << _options.resolution << "," << std::endl;
+    fs << "  \"max_impulse\": " << _options.maxImpulse << "," << std::endl;
+    fs << "  \"impulses\": " << Config::getInstance()->getImpulseSphere()->getImpulses().size() << "," << std::endl;
+    fs << "  \"gases\": " << _options.gasesSize << "," << std::endl;
+    fs << "  \"repeats\": " << _options.repeats << "," << std::endl;
+    fs << "  \"benchmarks\": [" << std::endl;
+    for (unsigned int ri = 0; ri < _results.size(); ri++) {
+        const auto& result = _results[ri];
+        fs << "    {\"name\": \"" << result.name << "\""
+           << ", \"item\": \"" << result.item << "\""
+           << ", \"items\": " << result.items
+           << ", \"min_seconds\": " << result.minSeconds
+           << ", \"mean_seconds\": " << result.meanSeconds
+           << ", \"ns_per_item\": " << result.minSeconds * 1e9 / result.items
+           << ", \"gb_per_second\": " << result.bytes / result.minSeconds * 1e-9
+           << "}" << (ri + 1 < _results.size() ? "," : "") << std::endl;
+    }
+    fs << "  ]" << std::endl;
+    fs << "}" << std::endl;
+
+    std::cout << std::endl << "Results written: " << _options.output << std::endl;
+}
+
+bool BenchmarkSuite::isSelected(const std::string& name) const {
+    return _options.filter.empty() || name.find(_options.filter) != std::string::npos;
+}
+
+void BenchmarkSuite::measure(const std::string& name, const std::string& item, double items, double bytes, const std::function<void()>& kernel) {
+    if (isSelected(name) == false) {
+        return;
+    }
+
+    // warm up caches and lazy allocations
+    kernel();
+
+    std::vector<double> times;
+    for (unsigned int repeat = 0; repeat < _options.repeats; repeat++) {
+        if (Parallel::isSingle() == false) {
+            Parallel::barrier();
+        }
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        times.push_back(duration.count());
+    }
+
+    // slowest rank defines time of parallel run
+    std::vector<double> amounts = {items, bytes};
+    if (Parallel::isSingle() == false) {
+        times = Parallel::allReduce(times, Parallel::Reduce::MAX);
+        amounts = Parallel::allReduce(amounts, Parallel::Reduce::SUM);
+    }
+
+    Result result;
+    result.name = name;
+    result.item = item;
+    result.items = amounts[0];
+    result.bytes = amounts[1];
+    result.minSeconds = *std::min_element(times.begin(), times.end());
+    result.meanSeconds = 0.0;
+    for (auto time : times) {
+        result.meanSeconds += time / times.size();
+    }
+    _results.push_back(result);
+}
@@ -0,0 +1,54 @@
+#ifndef RGS_BENCHMARKSUITE_H
+#define RGS_BENCHMARKSUITE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class Grid;
+
+// Micro-benchmarks of solver kernels on generated or gmsh mesh.
+class BenchmarkSuite {
+public:
+    struct Options {
+        std::string mesh = "generate:box:16x16x16";
+        unsigned int resolution = 20;
+        double maxImpulse = 4.8;
+        unsigned int gasesSize = 1;
+        unsigned int repeats = 5;
+        std::string filter;     // runs only benchmarks which names contain filter
+        std::string output = "bench.json";
+    };
+
+private:
+    struct Result {
+        std::string name;
+        std::string item;       // what one processed item is
+        double items;
+        double bytes;           // approximate memory traffic of one run
+        double minSeconds;
+        double meanSeconds;
+    };
+
+    Options _options;
+    Grid* _grid;
+    std::vector<Result> _results;
+
+public:
+    explicit BenchmarkSuite(Options options);
+
+    void init();
+
+    void run();
+
+    // prints table and writes json, on master only
+    void write() const;
+
+private:
+    bool isSelected(const std::string& name) const;
+
+    void measure(const std::string& name, const std::string& item, double items, double bytes, const std::function<void()>& kernel);
+
+};
+
+#endif //RGS_BENCHMARKSUITE_H
@@ -0,0 +1,78 @@
+#include "BenchmarkSuite.h"
+#include "utilities/Parallel.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+    void printUsage() {
+        std::cout << "usage: rgs_bench [--cells NXxNYxNZ | --mesh SPEC] [--resolution N] [--max-impulse P] [--gases N]" << std::endl
+                  << "                 [--repeats N] [--filter NAME] [--output FILE]" << std::endl;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    Parallel::init(&argc, &argv);
+
+    BenchmarkSuite::Options options;
+    for (int ai = 1; ai < argc; ai++) {
+        std::string arg = argv[ai];
+        if (arg == "--help") {
+            if (Parallel::isMaster()) {
+                printUsage();
+            }
+            Parallel::finalize();
+            return 0;
+        }
+        if (ai + 1 >= argc) {
+            if (Parallel::isMaster()) {
+                std::cout << "value required for argument: " << arg << std::endl;
+                printUsage();
+            }
+            Parallel::abort();
+        }
+        std::string value = argv[++ai];
+        if (arg == "--cells") {
+            if (value.find('x') == std::string::npos) {
+                value = value + "x" + value + "x" + value;
+            }
+            options.mesh = "generate:box:" + value;
+        } else if (arg == "--mesh") {
+            options.mesh = value;
+        } else if (arg == "--resolution") {
+            options.resolution = static_cast<unsigned int>(std::stoul(value));
+        } else if (arg == "--max-impulse") {
+            options.maxImpulse = std::stod(value);
+        } else if (arg == "--gases") {
+            options.gasesSize = static_cast<unsigned int>(std::stoul(value));
+        } else if (arg == "--repeats") {
+            options.repeats = static_cast<unsigned int>(std::stoul(value));
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            if (Parallel::isMaster()) {
+                std::cout << "unknown argument: " << arg << std::endl;
+                printUsage();
+            }
+            Parallel::abort();
+        }
+    }
+
+    try {
+        BenchmarkSuite suite(options);
+        suite.init();
+        suite.run();
+        suite.write();
+    } catch (const std::exception& e) {
+        std::cout << "Exception: " << e.what() << std::endl;
+        std::cout << std::endl;
+
+        Parallel::abort();
+    }
+
+    Parallel::finalize();
+}
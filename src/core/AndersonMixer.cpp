@@ -0,0 +1,181 @@
+#include "AndersonMixer.h"
+#include "Config.h"
+#include "grid/Grid.h"
+#include "parameters/ImpulseSphere.h"
+#include "utilities/Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+AndersonMixer::AndersonMixer(Grid* grid)
+: _grid(grid), _hasPrev(false), _mixesSize(0), _restartsSize(0) {
+    _isMoments = Config::getInstance()->getAndersonResidual() == "moments";
+}
+
+void AndersonMixer::mix() {
+    auto depth = Config::getInstance()->getAndersonDepth();
+
+    // values after steps are image of values of previous mix, nothing to mix on first call
+    auto image = _grid->getNormalValues();
+    if (_hasPrev == false) {
+        _prevValues = project(image);
+        _hasPrev = true;
+        return;
+    }
+
+    auto residual = project(image);
+    for (unsigned int i = 0; i < residual.size(); i++) {
+        residual[i] -= _prevValues[i];
+    }
+    if (_prevResidual.empty() == false) {
+        std::vector<double> residualDelta(residual.size()), imageDelta(image.size());
+        for (unsigned int i = 0; i < residual.size(); i++) {
+            residualDelta[i] = residual[i] - _prevResidual[i];
+        }
+        for (unsigned int i = 0; i < image.size(); i++) {
+            imageDelta[i] = image[i] - _prevImage[i];
+        }
+        _residualDeltas.push_back(std::move(residualDelta));
+        _imageDeltas.push_back(std::move(imageDelta));
+        while (_residualDeltas.size() > depth) {
+            _residualDeltas.pop_front();
+            _imageDeltas.pop_front();
+        }
+    }
+    _prevResidual = residual;
+    _prevImage = image;
+
+    // extrapolation is affine combination of images, so it keeps mass of closed grid,
+    // it is damped while it goes negative and dropped with history at last
+    auto values = image;
+    if (_residualDeltas.empty() == false) {
+        auto coefficients = solveLeastSquares(residual);
+        bool isFinite = std::all_of(coefficients.begin(), coefficients.end(), [](double c) { return std::isfinite(c); });
+
+        bool isAccepted = false;
+        double damping = 1.0;
+        for (unsigned int di = 0; di < 4 && isFinite && isAccepted == false; di++) {
+            double minValue = 0.0;
+            for (unsigned int i = 0; i < values.size(); i++) {
+                double value = image[i];
+                for (unsigned int hi = 0; hi < coefficients.size(); hi++) {
+                    value -= damping * coefficients[hi] * _imageDeltas[hi][i];
+                }
+                values[i] = value;
+                minValue = std::min(minValue, value);
+            }
+            if (Parallel::isSingle() == false) {
+                minValue = Parallel::allReduce({minValue}, Parallel::Reduce::MIN)[0];
+            }
+            isAccepted = minValue >= 0.0;
+            damping /= 2;
+        }
+        if (isAccepted) {
+            _mixesSize++;
+        } else {
+            values = image;
+            clearHistory();
+            _restartsSize++;
+        }
+        _grid->setNormalValues(values);
+    }
+    _prevValues = project(values);
+}
+
+std::vector<double> AndersonMixer::project(const std::vector<double>& values) const {
+    if (_isMoments == false) {
+        return values;
+    }
+
+    // density, momentum and energy of each cell and gas, impulses are taken relative to max one
+    auto impulseSphere = Config::getInstance()->getImpulseSphere();
+    const auto& impulses = impulseSphere->getImpulses();
+    double maxImpulse = impulseSphere->getMaxImpulse();
+    auto blocksSize = values.size() / impulses.size();
+
+    std::vector<double> moments(blocksSize * 5, 0.0);
+    for (unsigned int bi = 0; bi < blocksSize; bi++) {
+        const double* blockValues = &values[bi * impulses.size()];
+        double* blockMoments = &moments[bi * 5];
+        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+            Vector3d impulse = impulses[ii] / maxImpulse;
+            blockMoments[0] += blockValues[ii];
+            blockMoments[1] += blockValues[ii] * impulse.x();
+            blockMoments[2] += blockValues[ii] * impulse.y();
+            blockMoments[3] += blockValues[ii] * impulse.z();
+            blockMoments[4] += blockValues[ii] * impulse.moduleSquare();
+        }
+    }
+    return moments;
+}
+
+std::vector<double> AndersonMixer::solveLeastSquares(const std::vector<double>& residual) const {
+    auto size = _residualDeltas.size();
+
+    // normal equations, gram matrix and right side are summed over ranks together
+    std::vector<double> sums(size * size + size, 0.0);
+    for (unsigned int hi = 0; hi < size; hi++) {
+        const auto& delta = _residualDeltas[hi];
+        for (unsigned int hj = 0; hj <= hi; hj++) {
+            const auto& otherDelta = _residualDeltas[hj];
+            double sum = 0.0;
+            for (unsigned int i = 0; i < delta.size(); i++) {
+                sum += delta[i] * otherDelta[i];
+            }
+            sums[hi * size + hj] = sum;
+        }
+        double sum = 0.0;
+        for (unsigned int i = 0; i < delta.size(); i++) {
+            sum += delta[i] * residual[i];
+        }
+        sums[size * size + hi] = sum;
+    }
+    if (Parallel::isSingle() == false) {
+        sums = Parallel::allReduce(sums, Parallel::Reduce::SUM);
+    }
+
+    // deltas are nearly dependent close to solution, small regularization keeps matrix solvable
+    std::vector<std::vector<double>> matrix(size, std::vector<double>(size + 1));
+    double trace = 0.0;
+    for (unsigned int hi = 0; hi < size; hi++) {
+        trace += sums[hi * size + hi];
+    }
+    for (unsigned int hi = 0; hi < size; hi++) {
+        for (unsigned int hj = 0; hj < size; hj++) {
+            matrix[hi][hj] = hj <= hi ? sums[hi * size + hj] : sums[hj * size + hi];
+        }
+        matrix[hi][hi] += 1e-10 * trace / size;
+        matrix[hi][size] = sums[size * size + hi];
+    }
+
+    // gauss elimination with partial pivoting, the same on each rank
+    for (unsigned int k = 0; k < size; k++) {
+        unsigned int pivot = k;
+        for (unsigned int hi = k + 1; hi < size; hi++) {
+            if (std::abs(matrix[hi][k]) > std::abs(matrix[pivot][k])) {
+                pivot = hi;
+            }
+        }
+        std::swap(matrix[k], matrix[pivot]);
+        for (unsigned int hi = k + 1; hi < size; hi++) {
+            double factor = matrix[hi][k] / matrix[k][k];
+            for (unsigned int hj = k; hj <= size; hj++) {
+                matrix[hi][hj] -= factor * matrix[k][hj];
+            }
+        }
+    }
+    std::vector<double> coefficients(size);
+    for (int k = size - 1; k >= 0; k--) {
+        double value = matrix[k][size];
+        for (unsigned int hj = k + 1; hj < size; hj++) {
+            value -= matrix[k][hj] * coefficients[hj];
+        }
+        coefficients[k] = value / matrix[k][k];
+    }
+    return coefficients;
+}
+
+void AndersonMixer::clearHistory() {
+    _residualDeltas.clear();
+    _imageDeltas.clear();
+}
@@ -0,0 +1,53 @@
+#ifndef RGS_ANDERSONMIXER_H
+#define RGS_ANDERSONMIXER_H
+
+#include <deque>
+#include <vector>
+
+class Grid;
+
+// Anderson acceleration of time steps towards steady state. Each mix takes values after
+// some steps as image of values of previous mix and extrapolates over last images by
+// least squares of residuals. Residuals go in moments of cells by default: it keeps less memory,
+// and collisions keep moments, so noise of their nodes doesn't go into least squares.
+class AndersonMixer {
+private:
+    Grid* _grid;
+    bool _isMoments;                        // residuals are density, momentum and energy of cells
+
+    bool _hasPrev;
+    std::vector<double> _prevValues;        // of previous mix, projected in moments mode
+    std::vector<double> _prevImage;         // values before previous mix
+    std::vector<double> _prevResidual;
+    std::deque<std::vector<double>> _residualDeltas;
+    std::deque<std::vector<double>> _imageDeltas;
+
+    unsigned int _mixesSize;
+    unsigned int _restartsSize;             // history is dropped when extrapolation goes negative
+
+public:
+    explicit AndersonMixer(Grid* grid);
+
+    // collective, replaces values after steps by extrapolation
+    void mix();
+
+    unsigned int getMixesSize() const {
+        return _mixesSize;
+    }
+
+    unsigned int getRestartsSize() const {
+        return _restartsSize;
+    }
+
+private:
+    // values in space of residuals
+    std::vector<double> project(const std::vector<double>& values) const;
+
+    // collective, coefficients of deltas closest to residual
+    std::vector<double> solveLeastSquares(const std::vector<double>& residual) const;
+
+    void clearHistory();
+
+};
+
+#endif //RGS_ANDERSONMIXER_H
@@ -0,0 +1,305 @@
+#include "Checkpoint.h"
+#include "Config.h"
+#include "grid/Grid.h"
+#include "grid/NormalCell.h"
+#include "integral/ci.hpp"
+#include "utilities/Parallel.h"
+#include "utilities/Utils.h"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char Checkpoint::MAGIC[8] = {'R', 'G', 'S', 'C', 'K', 'P', 'T', '\0'};
+
+namespace {
+
+    void writeBuffer(int fd, const std::string& buffer) {
+        std::size_t written = 0;
+        while (written < buffer.size()) {
+            auto result = ::write(fd, buffer.data() + written, buffer.size() - written);
+            if (result < 0) {
+                throw std::runtime_error("checkpoint write failed");
+            }
+            written += static_cast<std::size_t>(result);
+        }
+    }
+
+}
+
+Checkpoint::Checkpoint(Grid* grid, std::string folder) : _grid(grid), _folder(std::move(folder)) {}
+
+void Checkpoint::write(unsigned int iteration) {
+    boost::filesystem::path checkpointPath = boost::filesystem::path(_folder) / getCheckpointFolder(iteration);
+    if (Parallel::isMaster() == true) {
+        boost::filesystem::create_directories(checkpointPath);
+    }
+    Parallel::barrier();
+
+    writeFile((checkpointPath / getRankFilename(Parallel::getRank())).generic_string(), iteration);
+
+    // manifest goes only after all ranks have their files on disk
+    Parallel::barrier();
+    if (Parallel::isMaster() == true) {
+        writeManifest(iteration, getCheckpointFolder(iteration));
+    }
+}
+
+unsigned int Checkpoint::restore(const std::string& folder) {
+    boost::filesystem::path manifestPath = boost::filesystem::path(folder) / "manifest.txt";
+    std::ifstream fs(manifestPath.generic_string());
+    if (fs.is_open() == false) {
+        throw std::runtime_error("checkpoint manifest not found: " + manifestPath.generic_string());
+    }
+
+    unsigned int iteration = 0;
+    int ranks = 0;
+    std::string checkpointFolder;
+    std::string key;
+    while (fs >> key) {
+        if (key == "iteration") {
+            fs >> iteration;
+        } else if (key == "ranks") {
+            fs >> ranks;
+        } else if (key == "folder") {
+            fs >> checkpointFolder;
+        }
+    }
+
+    // the same number of ranks gives the same partition, so rank reads only own file,
+    // otherwise cells are looked up in files of all ranks
+    unsigned int loadedSize = 0;
+    if (ranks == Parallel::getSize()) {
+        auto filePath = boost::filesystem::path(folder) / checkpointFolder / getRankFilename(Parallel::getRank());
+        loadedSize = readFile(filePath.generic_string(), true);
+    }
+    if (loadedSize != _grid->getNormalCells().size()) {
+        for (int rank = 0; rank < ranks; rank++) {
+            bool isOwnRank = rank == Parallel::getRank() || (rank == 0 && Parallel::getRank() >= ranks);
+            auto filePath = boost::filesystem::path(folder) / checkpointFolder / getRankFilename(rank);
+            readFile(filePath.generic_string(), isOwnRank);
+        }
+    }
+
+    // restored checkpoint is kept on disk until the next one is complete
+    _previousFolder = checkpointFolder;
+
+    if (Parallel::isMaster() == true) {
+        std::cout << "Restarted from checkpoint: " << folder << "; iteration = " << iteration << std::endl;
+    }
+
+    return iteration;
+}
+
+void Checkpoint::writeFile(const std::string& filename, unsigned int iteration) {
+    auto config = Config::getInstance();
+    auto impulseSphere = config->getImpulseSphere();
+    const auto& normalCells = _grid->getNormalCells();
+
+    std::string randomState = ci::getRandomState();
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.rank = static_cast<uint32_t>(Parallel::getRank());
+    header.iteration = iteration;
+    header.gasesSize = static_cast<uint32_t>(config->getGases().size());
+    header.impulsesSize = static_cast<uint32_t>(impulseSphere->getImpulses().size());
+    header.resolution = impulseSphere->getResolution();
+    header.maxImpulse = impulseSphere->getMaxImpulse();
+    header.timestep = config->getTimestep();
+    header.cellsSize = normalCells.size();
+    header.randomStateSize = randomState.size();
+
+    // write to temporary file, so previous checkpoint stays valid if we fail here
+    std::string tempFilename = filename + ".tmp";
+    int fd = ::open(tempFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("can't open checkpoint file: " + tempFilename);
+    }
+
+    std::string buffer;
+    buffer.append(reinterpret_cast<const char*>(&header), sizeof(Header));
+    buffer.append(randomState);
+
+    const std::size_t flushSize = 1 << 22;
+    for (auto cell : normalCells) {
+        auto id = static_cast<int32_t>(cell->getId());
+        buffer.append(reinterpret_cast<const char*>(&id), sizeof(int32_t));
+        for (const auto& values : cell->getValues()) {
+            buffer.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+        }
+        if (buffer.size() > flushSize) {
+            writeBuffer(fd, buffer);
+            buffer.clear();
+        }
+    }
+    writeBuffer(fd, buffer);
+
+    if (::fsync(fd) != 0) {
+        ::close(fd);
+        throw std::runtime_error("can't sync checkpoint file: " + tempFilename);
+    }
+    ::close(fd);
+
+    if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        throw std::runtime_error("can't rename checkpoint file: " + tempFilename);
+    }
+}
+
+unsigned int Checkpoint::readFile(const std::string& filename, bool isOwnRank) {
+    auto config = Config::getInstance();
+    auto impulseSphere = config->getImpulseSphere();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open checkpoint file: " + filename);
+    }
+    struct stat fileStat{};
+    if (::fstat(fd, &fileStat) != 0 || static_cast<std::size_t>(fileStat.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("wrong checkpoint file: " + filename);
+    }
+    auto size = static_cast<std::size_t>(fileStat.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("can't map checkpoint file: " + filename);
+    }
+    const char* data = static_cast<const char*>(mapping);
+
+    unsigned int loadedSize = 0;
+    try {
+        Header header{};
+        std::memcpy(&header, data, sizeof(Header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+            throw std::runtime_error("wrong checkpoint file: " + filename);
+        }
+        if (header.gasesSize != config->getGases().size()) {
+            throw std::runtime_error("checkpoint has different number of gases: " + filename);
+        }
+
+        // checkpoint from other velocity grid is interpolated onto current one
+        bool isSameSphere = header.resolution == impulseSphere->getResolution() && header.maxImpulse == impulseSphere->getMaxImpulse();
+        std::unique_ptr<ImpulseSphere> fromSphere;
+        if (isSameSphere == false) {
+            fromSphere.reset(new ImpulseSphere(header.maxImpulse, header.resolution));
+            fromSphere->init();
+            if (header.impulsesSize != fromSphere->getImpulses().size()) {
+                throw std::runtime_error("checkpoint has wrong impulse sphere: " + filename);
+            }
+        }
+
+        std::size_t recordSize = sizeof(int32_t) + header.gasesSize * header.impulsesSize * sizeof(double);
+        std::size_t offset = sizeof(Header) + header.randomStateSize;
+        if (offset + header.cellsSize * recordSize > size) {
+            throw std::runtime_error("checkpoint file is truncated: " + filename);
+        }
+
+        if (isOwnRank == true) {
+
+            // timestep depends on max impulse, so it's kept only for the same sphere
+            if (isSameSphere == true) {
+                config->setTimestep(header.timestep);
+            }
+            ci::setRandomState(std::string(data + sizeof(Header), header.randomStateSize));
+        }
+
+        std::unordered_map<int, NormalCell*> cellsMap;
+        for (auto cell : _grid->getNormalCells()) {
+            cellsMap[cell->getId()] = cell;
+        }
+
+        for (uint64_t ci = 0; ci < header.cellsSize; ci++) {
+            const char* record = data + offset + ci * recordSize;
+            int32_t id;
+            std::memcpy(&id, record, sizeof(int32_t));
+
+            auto pos = cellsMap.find(id);
+            if (pos == cellsMap.end()) {
+                continue;
+            }
+
+            loadedSize++;
+            const char* values = record + sizeof(int32_t);
+            auto& cellValues = pos->second->getValues();
+            for (uint32_t gi = 0; gi < header.gasesSize; gi++) {
+                const char* gasValues = values + gi * header.impulsesSize * sizeof(double);
+                if (isSameSphere == true) {
+                    std::memcpy(cellValues[gi].data(), gasValues, header.impulsesSize * sizeof(double));
+                } else {
+                    std::vector<double> fromValues(header.impulsesSize);
+                    std::memcpy(fromValues.data(), gasValues, header.impulsesSize * sizeof(double));
+                    cellValues[gi] = impulseSphere->interpolate(*fromSphere, fromValues);
+                }
+            }
+        }
+    } catch (...) {
+        ::munmap(mapping, size);
+        throw;
+    }
+
+    ::munmap(mapping, size);
+    return loadedSize;
+}
+
+void Checkpoint::writeManifest(unsigned int iteration, const std::string& checkpointFolder) {
+    boost::filesystem::path folderPath(_folder);
+    std::string filename = (folderPath / "manifest.txt").generic_string();
+    std::string tempFilename = filename + ".tmp";
+
+    {
+        std::ofstream fs(tempFilename, std::ios::out | std::ios::trunc);
+        fs << "iteration " << iteration << std::endl;
+        fs << "ranks " << Parallel::getSize() << std::endl;
+        fs << "folder " << checkpointFolder << std::endl;
+        if (fs.good() == false) {
+            throw std::runtime_error("can't write checkpoint manifest: " + tempFilename);
+        }
+    }
+    syncFile(tempFilename);
+
+    if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        throw std::runtime_error("can't rename checkpoint manifest: " + tempFilename);
+    }
+    syncFile(folderPath.generic_string());
+
+    // keep previous checkpoint in case the latest one is broken, remove older ones
+    for (boost::filesystem::directory_iterator it(folderPath), end; it != end; ++it) {
+        std::string name = it->path().filename().generic_string();
+        if (boost::filesystem::is_directory(it->path()) == false || name.find("iteration_") != 0) {
+            continue;
+        }
+        unsigned int otherIteration = std::stoul(name.substr(std::string("iteration_").size()));
+        if (otherIteration < iteration && name != _previousFolder) {
+            boost::filesystem::remove_all(it->path());
+        }
+    }
+    _previousFolder = checkpointFolder;
+}
+
+void Checkpoint::syncFile(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open for sync: " + filename);
+    }
+    ::fsync(fd);
+    ::close(fd);
+}
+
+std::string Checkpoint::getCheckpointFolder(unsigned int iteration) {
+    return "iteration_" + Utils::toString(iteration);
+}
+
+std::string Checkpoint::getRankFilename(int rank) {
+    return "rank_" + Utils::toString(rank) + ".bin";
+}
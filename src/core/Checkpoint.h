@@ -0,0 +1,61 @@
+#ifndef RGS_CHECKPOINT_H
+#define RGS_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class Grid;
+
+// Saves and loads distribution functions of all normal cells.
+// Each rank writes own file, then master writes manifest pointing to complete checkpoint.
+class Checkpoint {
+private:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t rank;
+        uint32_t iteration;
+        uint32_t gasesSize;
+        uint32_t impulsesSize;
+        uint32_t resolution;
+        double maxImpulse;
+        double timestep;
+        uint64_t cellsSize;
+        uint64_t randomStateSize;
+    };
+
+    Grid* _grid;
+    std::string _folder;
+    std::string _previousFolder;  // kept on disk until the next checkpoint is complete
+
+public:
+    Checkpoint(Grid* grid, std::string folder);
+
+    // collective, all ranks must call it
+    void write(unsigned int iteration);
+
+    // collective, returns iteration of loaded checkpoint
+    unsigned int restore(const std::string& folder);
+
+private:
+    void writeFile(const std::string& filename, unsigned int iteration);
+
+    // returns number of cells of grid found in file
+    unsigned int readFile(const std::string& filename, bool isOwnRank);
+
+    void writeManifest(unsigned int iteration, const std::string& checkpointFolder);
+
+    static void syncFile(const std::string& filename);
+
+    static std::string getCheckpointFolder(unsigned int iteration);
+
+    static std::string getRankFilename(int rank);
+
+};
+
+
+#endif //RGS_CHECKPOINT_H
@@ -1,6 +1,8 @@
 #include "Config.h"
 
+#include <algorithm>
 #include <sstream>
+#include <stdexcept>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/filesystem/path.hpp>
@@ -128,15 +130,65 @@ void Config::load(const std::string& filename) {
     boost::property_tree::ptree root;
     boost::property_tree::read_json(filename, root);
 
+    load(root);
+}
+
+void Config::load(const boost::property_tree::ptree& root) {
+
     _meshFilename = root.get<std::string>("mesh", "");
     _meshUnits = root.get<double>("mesh_units", 1.0);
 
     _outputFolder = root.get<std::string>("output_folder", "./");
+    _outputFormat = root.get<std::string>("output_format", "pvtu");
+    _outputEncoding = root.get<std::string>("output_encoding", "binary");
     _maxIterations = root.get<unsigned int>("max_iterations", 0);
     _outEachIteration = root.get<unsigned int>("out_each_iteration", 1);
+    _outputQueueSize = root.get<unsigned int>("output_queue_size", 2);
+    _checkpointFolder = root.get<std::string>("checkpoint_folder", (boost::filesystem::path(_outputFolder) / "checkpoint").generic_string());
+    _restartFolder = root.get<std::string>("restart_folder", "");
+    _checkpointEachIteration = root.get<unsigned int>("checkpoint_each_iteration", 0);
+    _isUsingProfiler = root.get<bool>("use_profiler", false);
+    _profileEachIteration = root.get<unsigned int>("profile_each_iteration", 0);
+    _isUsingTrace = root.get<bool>("use_trace", false);
+    _traceStartIteration = root.get<unsigned int>("trace_start_iteration", 1);
+    _traceEndIteration = root.get<unsigned int>("trace_end_iteration", 0);
+    _residualEachIteration = root.get<unsigned int>("residual_each_iteration", 0);
+    _residualDensityTolerance = root.get<double>("residual_density_tolerance", 0.0);
+    _residualVelocityTolerance = root.get<double>("residual_velocity_tolerance", 0.0);
+    _residualTemperatureTolerance = root.get<double>("residual_temperature_tolerance", 0.0);
+    _residualNorm = root.get<std::string>("residual_norm", "l2");
     _isUsingIntegral = root.get<bool>("use_integral", false);
     _isUsingBetaDecay = root.get<bool>("use_beta_decay", false);
     _isImplicitScheme = root.get<bool>("use_implicit_scheme", false);
+    _sweepThreads = root.get<unsigned int>("sweep_threads", 1);
+    _isUsingLocalTimestep = root.get<bool>("use_local_timestep", false);
+    _localTimestepMaxScale = root.get<double>("local_timestep_max_scale", 0.0);
+    _isUsingMultirateTimestep = root.get<bool>("use_multirate_timestep", false);
+    _multirateMaxLevel = root.get<unsigned int>("multirate_max_level", 3);
+    _steadySolver = root.get<std::string>("steady_solver", "march");
+    _jfnkKrylovSize = root.get<unsigned int>("jfnk_krylov_size", 20);
+    _jfnkKrylovTolerance = root.get<double>("jfnk_krylov_tolerance", 1e-2);
+    _jfnkPreconditionerScale = root.get<double>("jfnk_preconditioner_scale", 10.0);
+    _jfnkTolerance = root.get<double>("jfnk_tolerance", 0.0);
+    _andersonDepth = root.get<unsigned int>("anderson_depth", 5);
+    _andersonEachIteration = root.get<unsigned int>("anderson_each_iteration", 5);
+    _andersonResidual = root.get<std::string>("anderson_residual", "moments");
+    _multigridLevels = root.get<unsigned int>("multigrid_levels", 8);
+    _multigridCycle = root.get<std::string>("multigrid_cycle", "V");
+    _multigridSmoothingSteps = root.get<unsigned int>("multigrid_smoothing_steps", 1);
+    _multigridCorrectionDamping = root.get<double>("multigrid_correction_damping", 0.7);
+    _multigridFineSteps = root.get<unsigned int>("multigrid_fine_steps", 3);
+    _collisionSkipTolerance = root.get<double>("collision_skip_tolerance", 0.0);
+    _collisionSkipEachIteration = root.get<unsigned int>("collision_skip_each_iteration", 10);
+    _modelCollisionKnudsen = root.get<double>("model_collision_knudsen", 0.0);
+    _spectralAngles = root.get<unsigned int>("spectral_angles", 4);
+
+    auto impulseSphereNode = root.get_child_optional("impulse_sphere");
+    if (impulseSphereNode) {
+        auto maxImpulse = impulseSphereNode->get<double>("max_impulse", 4.8);
+        auto resolution = impulseSphereNode->get<unsigned int>("resolution", 20);
+        _impulseSphere.reset(new ImpulseSphere(maxImpulse, resolution));
+    }
 
     _gases.clear();
     auto gasesNode = root.get_child_optional("gases");
@@ -161,6 +213,29 @@ void Config::load(const std::string& filename) {
         }
     }
 
+    _spectralPairs.clear();
+    auto spectralPairsNode = root.get_child_optional("spectral_pairs");
+    if (spectralPairsNode) {
+        for (const boost::property_tree::ptree::value_type& pairNode : *spectralPairsNode) {
+            std::vector<unsigned int> pair;
+            for (const boost::property_tree::ptree::value_type& value : pairNode.second) {
+                pair.emplace_back(value.second.get_value<unsigned int>());
+            }
+            if (pair.size() != 2) {
+                throw std::runtime_error("spectral pair must have two gases");
+            }
+
+            // other pairs are never computed, so their kernels would be silently unused
+            auto collisionPairs = getCollisionPairs();
+            auto key = std::make_pair(std::min(pair[0], pair[1]), std::max(pair[0], pair[1]));
+            if (std::find(collisionPairs.begin(), collisionPairs.end(), key) == collisionPairs.end()) {
+                throw std::runtime_error("spectral pair " + std::to_string(pair[0]) + "-" + std::to_string(pair[1]) +
+                                         " is not computed, pairs are gas 0 with itself and with gases 1 and 2");
+            }
+            _spectralPairs.push_back(pair);
+        }
+    }
+
     _initialParameters.clear();
     auto initalNode = root.get_child_optional("initial");
     if (initalNode) {
@@ -324,13 +399,66 @@ void Config::load(const std::string& filename) {
     }
 }
 
+std::vector<std::pair<unsigned int, unsigned int>> Config::getCollisionPairs() const {
+    std::vector<std::pair<unsigned int, unsigned int>> pairs;
+    if (_gases.empty() == false) {
+        pairs.emplace_back(0, 0);
+    }
+    for (unsigned int gi = 1; gi < std::min<unsigned int>(_gases.size(), 3); gi++) {
+        pairs.emplace_back(0, gi);
+    }
+    return pairs;
+}
+
 std::ostream& operator<<(std::ostream& os, const Config& config) {
     os << "mesh_filename = "      << config._meshFilename                        << std::endl
        << "output_folder = "      << config._outputFolder                        << std::endl
+       << "output_format = "      << config._outputFormat                        << std::endl
+       << "output_encoding = "    << config._outputEncoding                      << std::endl
        << "max_iteration = "      << config._maxIterations                       << std::endl
        << "out_each_iteration = " << config._outEachIteration                    << std::endl
-       << "use_integral = "       << config._isUsingIntegral                     << std::endl
-       << "use_beta_decay = "     << config._isUsingBetaDecay                    << std::endl;
+       << "output_queue_size = "  << config._outputQueueSize                     << std::endl
+       << "checkpoint_folder = "  << config._checkpointFolder                    << std::endl
+       << "restart_folder = "     << config._restartFolder                       << std::endl
+       << "checkpoint_each_iteration = " << config._checkpointEachIteration      << std::endl
+       << "use_profiler = "       << config._isUsingProfiler                     << std::endl
+       << "profile_each_iteration = " << config._profileEachIteration            << std::endl
+       << "use_trace = "          << config._isUsingTrace                        << std::endl
+       << "trace_iterations = "   << config._traceStartIteration << "-" << config._traceEndIteration << std::endl
+       << "residual_each_iteration = " << config._residualEachIteration          << std::endl
+       << "residual_tolerances = "     << config._residualNorm << " "
+                                       << config._residualDensityTolerance << " "
+                                       << config._residualVelocityTolerance << " "
+                                       << config._residualTemperatureTolerance    << std::endl
+       << "use_integral = "       << config._isUsingIntegral
+       << " (collision_skip_tolerance = " << config._collisionSkipTolerance
+       << ", collision_skip_each_iteration = " << config._collisionSkipEachIteration
+       << ", model_collision_knudsen = " << config._modelCollisionKnudsen
+       << ", spectral_pairs = [";
+    for (const auto& pair : config._spectralPairs) {
+        os << (&pair == &config._spectralPairs.front() ? "" : ", ") << pair[0] << "-" << pair[1];
+    }
+    os << "], spectral_angles = " << config._spectralAngles << ")" << std::endl
+       << "use_beta_decay = "     << config._isUsingBetaDecay                    << std::endl
+       << "use_implicit_scheme = " << config._isImplicitScheme
+       << " (sweep_threads = " << config._sweepThreads << ")"                     << std::endl
+       << "use_local_timestep = " << config._isUsingLocalTimestep
+       << " (max_scale = " << config._localTimestepMaxScale << ")"               << std::endl
+       << "use_multirate_timestep = " << config._isUsingMultirateTimestep
+       << " (max_level = " << config._multirateMaxLevel << ")"                   << std::endl
+       << "steady_solver = "      << config._steadySolver
+       << " (krylov_size = " << config._jfnkKrylovSize
+       << ", krylov_tolerance = " << config._jfnkKrylovTolerance
+       << ", preconditioner_scale = " << config._jfnkPreconditionerScale
+       << ", tolerance = " << config._jfnkTolerance
+       << "; anderson_depth = " << config._andersonDepth
+       << ", anderson_each_iteration = " << config._andersonEachIteration
+       << ", anderson_residual = " << config._andersonResidual
+       << "; multigrid_levels = " << config._multigridLevels
+       << ", multigrid_cycle = " << config._multigridCycle
+       << ", multigrid_smoothing_steps = " << config._multigridSmoothingSteps
+       << ", multigrid_correction_damping = " << config._multigridCorrectionDamping
+       << ", multigrid_fine_steps = " << config._multigridFineSteps << ")" << std::endl;
 
     os << "gases = "              << Utils::toString(config._gases)              << std::endl;
     os << "beta_chains = "        << Utils::toString(config._betaChains)         << std::endl;
@@ -16,6 +16,7 @@
 
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/shared_ptr.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
 
 class Config {
     friend class boost::serialization::access;
@@ -26,9 +27,29 @@ private:
     double _meshUnits;
 
     std::string _outputFolder;
+    std::string _outputFormat;
+    std::string _outputEncoding;
 
     unsigned int _maxIterations;
     unsigned int _outEachIteration;
+    unsigned int _outputQueueSize;
+
+    std::string _checkpointFolder;
+    std::string _restartFolder;
+    unsigned int _checkpointEachIteration;
+
+    bool _isUsingProfiler;
+    unsigned int _profileEachIteration;
+
+    bool _isUsingTrace;
+    unsigned int _traceStartIteration;
+    unsigned int _traceEndIteration;
+
+    unsigned int _residualEachIteration;
+    double _residualDensityTolerance;
+    double _residualVelocityTolerance;
+    double _residualTemperatureTolerance;
+    std::string _residualNorm;
 
     bool _isUsingIntegral;
     bool _isUsingBetaDecay;
@@ -45,6 +66,32 @@ private:
     double _timestep;
 
     bool _isImplicitScheme;
+    unsigned int _sweepThreads;
+
+    bool _isUsingLocalTimestep;
+    double _localTimestepMaxScale;
+
+    bool _isUsingMultirateTimestep;
+    unsigned int _multirateMaxLevel;
+
+    std::string _steadySolver;
+    unsigned int _jfnkKrylovSize;
+    double _jfnkKrylovTolerance;
+    double _jfnkPreconditionerScale;
+    double _jfnkTolerance;
+    unsigned int _andersonDepth;
+    unsigned int _andersonEachIteration;
+    std::string _andersonResidual;
+    unsigned int _multigridLevels;
+    std::string _multigridCycle;
+    unsigned int _multigridSmoothingSteps;
+    double _multigridCorrectionDamping;
+    unsigned int _multigridFineSteps;
+    double _collisionSkipTolerance;
+    unsigned int _collisionSkipEachIteration;
+    double _modelCollisionKnudsen;
+    std::vector<std::vector<unsigned int>> _spectralPairs;
+    unsigned int _spectralAngles;
 
     static Config* _instance;
 
@@ -66,6 +113,9 @@ public:
 
     void load(const std::string& filename);
 
+    // loads from already parsed json, name is kept
+    void load(const boost::property_tree::ptree& root);
+
     const std::string& getName() const {
         return _name;
     }
@@ -82,6 +132,14 @@ public:
         return _outputFolder;
     }
 
+    const std::string& getOutputFormat() const {
+        return _outputFormat;
+    }
+
+    const std::string& getOutputEncoding() const {
+        return _outputEncoding;
+    }
+
     unsigned int getMaxIterations() const {
         return _maxIterations;
     }
@@ -90,10 +148,161 @@ public:
         return _outEachIteration;
     }
 
+    unsigned int getOutputQueueSize() const {
+        return _outputQueueSize;
+    }
+
+    const std::string& getCheckpointFolder() const {
+        return _checkpointFolder;
+    }
+
+    const std::string& getRestartFolder() const {
+        return _restartFolder;
+    }
+
+    unsigned int getCheckpointEachIteration() const {
+        return _checkpointEachIteration;
+    }
+
+    bool isUsingProfiler() const {
+        return _isUsingProfiler;
+    }
+
+    unsigned int getProfileEachIteration() const {
+        return _profileEachIteration;
+    }
+
+    bool isUsingTrace() const {
+        return _isUsingTrace;
+    }
+
+    unsigned int getTraceStartIteration() const {
+        return _traceStartIteration;
+    }
+
+    unsigned int getTraceEndIteration() const {
+        return _traceEndIteration;
+    }
+
+    unsigned int getResidualEachIteration() const {
+        return _residualEachIteration;
+    }
+
+    double getResidualDensityTolerance() const {
+        return _residualDensityTolerance;
+    }
+
+    double getResidualVelocityTolerance() const {
+        return _residualVelocityTolerance;
+    }
+
+    double getResidualTemperatureTolerance() const {
+        return _residualTemperatureTolerance;
+    }
+
+    const std::string& getResidualNorm() const {
+        return _residualNorm;
+    }
+
     bool isUsingIntegral() const {
         return _isUsingIntegral;
     }
 
+    unsigned int getSweepThreads() const {
+        return _sweepThreads;
+    }
+
+    bool isUsingLocalTimestep() const {
+        return _isUsingLocalTimestep;
+    }
+
+    double getLocalTimestepMaxScale() const {
+        return _localTimestepMaxScale;
+    }
+
+    bool isUsingMultirateTimestep() const {
+        return _isUsingMultirateTimestep;
+    }
+
+    unsigned int getMultirateMaxLevel() const {
+        return _multirateMaxLevel;
+    }
+
+    const std::string& getSteadySolver() const {
+        return _steadySolver;
+    }
+
+    unsigned int getJfnkKrylovSize() const {
+        return _jfnkKrylovSize;
+    }
+
+    double getJfnkKrylovTolerance() const {
+        return _jfnkKrylovTolerance;
+    }
+
+    double getJfnkPreconditionerScale() const {
+        return _jfnkPreconditionerScale;
+    }
+
+    double getJfnkTolerance() const {
+        return _jfnkTolerance;
+    }
+
+    unsigned int getAndersonDepth() const {
+        return _andersonDepth;
+    }
+
+    unsigned int getAndersonEachIteration() const {
+        return _andersonEachIteration;
+    }
+
+    const std::string& getAndersonResidual() const {
+        return _andersonResidual;
+    }
+
+    unsigned int getMultigridLevels() const {
+        return _multigridLevels;
+    }
+
+    const std::string& getMultigridCycle() const {
+        return _multigridCycle;
+    }
+
+    unsigned int getMultigridSmoothingSteps() const {
+        return _multigridSmoothingSteps;
+    }
+
+    double getMultigridCorrectionDamping() const {
+        return _multigridCorrectionDamping;
+    }
+
+    unsigned int getMultigridFineSteps() const {
+        return _multigridFineSteps;
+    }
+
+    double getCollisionSkipTolerance() const {
+        return _collisionSkipTolerance;
+    }
+
+    unsigned int getCollisionSkipEachIteration() const {
+        return _collisionSkipEachIteration;
+    }
+
+    double getModelCollisionKnudsen() const {
+        return _modelCollisionKnudsen;
+    }
+
+    const std::vector<std::vector<unsigned int>>& getSpectralPairs() const {
+        return _spectralPairs;
+    }
+
+    // gases pairs of collision integral, lesser gas goes first: gas 0 with itself and with gases 1 and 2
+    std::vector<std::pair<unsigned int, unsigned int>> getCollisionPairs() const;
+
+    unsigned int getSpectralAngles() const {
+        return _spectralAngles;
+    }
+
     bool isUsingBetaDecay() const {
         return _isUsingBetaDecay;
     }
@@ -143,9 +352,29 @@ private:
         ar & _meshFilename;
         ar & _meshUnits;
         ar & _outputFolder;
+        ar & _outputFormat;
+        ar & _outputEncoding;
 
         ar & _maxIterations;
         ar & _outEachIteration;
+        ar & _outputQueueSize;
+
+        ar & _checkpointFolder;
+        ar & _restartFolder;
+        ar & _checkpointEachIteration;
+
+        ar & _isUsingProfiler;
+        ar & _profileEachIteration;
+
+        ar & _isUsingTrace;
+        ar & _traceStartIteration;
+        ar & _traceEndIteration;
+
+        ar & _residualEachIteration;
+        ar & _residualDensityTolerance;
+        ar & _residualVelocityTolerance;
+        ar & _residualTemperatureTolerance;
+        ar & _residualNorm;
 
         ar & _isUsingIntegral;
         ar & _isUsingBetaDecay;
@@ -160,6 +389,32 @@ private:
         ar & _impulseSphere;
 
         ar & _isImplicitScheme;
+        ar & _sweepThreads;
+
+        ar & _isUsingLocalTimestep;
+        ar & _localTimestepMaxScale;
+
+        ar & _isUsingMultirateTimestep;
+        ar & _multirateMaxLevel;
+
+        ar & _steadySolver;
+        ar & _jfnkKrylovSize;
+        ar & _jfnkKrylovTolerance;
+        ar & _jfnkPreconditionerScale;
+        ar & _jfnkTolerance;
+        ar & _andersonDepth;
+        ar & _andersonEachIteration;
+        ar & _andersonResidual;
+        ar & _multigridLevels;
+        ar & _multigridCycle;
+        ar & _multigridSmoothingSteps;
+        ar & _multigridCorrectionDamping;
+        ar & _multigridFineSteps;
+        ar & _collisionSkipTolerance;
+        ar & _collisionSkipEachIteration;
+        ar & _modelCollisionKnudsen;
+        ar & _spectralPairs;
+        ar & _spectralAngles;
     }
 
 };
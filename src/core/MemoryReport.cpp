@@ -0,0 +1,444 @@
+#include "MemoryReport.h"
+#include "Config.h"
+#include "grid/Grid.h"
+#include "grid/NormalCell.h"
+#include "grid/BorderCell.h"
+#include "grid/ParallelCell.h"
+#include "grid/CellConnection.h"
+#include "grid/CellResults.h"
+#include "grid/SweepSchedule.h"
+#include "mesh/Mesh.h"
+#include "integral/ci.hpp"
+#include "integral/ci_impl.hpp"
+#include "utilities/Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+
+namespace {
+
+    // malloc chunk header and alignment of each heap allocation
+    const double HEAP_BYTES = 16.0;
+
+    // std::map red-black tree node header
+    const double MAP_NODE_BYTES = 32.0 + HEAP_BYTES;
+
+    // control block of shared_ptr created from raw pointer
+    const double SHARED_BLOCK_BYTES = 24.0 + HEAP_BYTES;
+
+    // korobov points per ci::gen call, as in Grid::computeIntegral
+    const double COLLISION_NODES_SIZE = 50000.0;
+
+    double getVectorBytes(std::size_t capacity, std::size_t itemBytes) {
+        return capacity > 0 ? capacity * itemBytes + HEAP_BYTES : 0.0;
+    }
+
+    double getVectorBytes(const std::vector<std::vector<double>>& values) {
+        double bytes = getVectorBytes(values.capacity(), sizeof(std::vector<double>));
+        for (const auto& gasValues : values) {
+            bytes += getVectorBytes(gasValues.capacity(), sizeof(double));
+        }
+        return bytes;
+    }
+
+    // heap part of cell parameters, object itself is inside of cell
+    double getParametersBytes() {
+        std::size_t gasesSize = Config::getInstance()->getGases().size();
+        return 3 * getVectorBytes(gasesSize, sizeof(double)) + 2 * getVectorBytes(gasesSize, sizeof(Vector3d));
+    }
+
+    // common part of each cell: shared pointer in grid, map entry and typed pointer
+    double getCellBytes(std::size_t cellBytes) {
+        return cellBytes + HEAP_BYTES + SHARED_BLOCK_BYTES + sizeof(std::shared_ptr<BaseCell>) +
+               MAP_NODE_BYTES + sizeof(std::pair<const int, BaseCell*>) + sizeof(BaseCell*);
+    }
+
+    double getNormalCellBytes() {
+        return getCellBytes(sizeof(NormalCell)) + getParametersBytes() +
+               sizeof(CellResults) + HEAP_BYTES + SHARED_BLOCK_BYTES + getParametersBytes();
+    }
+
+    double getBorderCellBytes() {
+        std::size_t gasesSize = Config::getInstance()->getGases().size();
+        return getCellBytes(sizeof(BorderCell)) + getParametersBytes() +
+               getVectorBytes(gasesSize, sizeof(BorderCell::BorderType)) +
+               getVectorBytes(gasesSize, sizeof(const MaxwellianCache::Table*)) + getVectorBytes(gasesSize, sizeof(double));
+    }
+
+    // groups of sweep schedule with all impulses and one work item for each thread of group
+    double getSweepGroupsBytes(double groupsSize) {
+        auto config = Config::getInstance();
+        double impulsesSize = config->getImpulseSphere()->getImpulses().size();
+        double threadsSize = config->getSweepThreads() != 0 ? config->getSweepThreads() : std::max(std::thread::hardware_concurrency(), 1u);
+        return groupsSize * (sizeof(SweepSchedule::Group) + HEAP_BYTES) + impulsesSize * sizeof(unsigned int) +
+               groupsSize * threadsSize * 3 * sizeof(unsigned int);
+    }
+
+    // one table of maxwellian cache with its map node
+    double getMaxwellianTableBytes() {
+        std::size_t impulsesSize = Config::getInstance()->getImpulseSphere()->getImpulses().size();
+        return MAP_NODE_BYTES + sizeof(std::pair<const std::pair<unsigned int, double>, MaxwellianCache::Table>) +
+               getVectorBytes(impulsesSize, sizeof(double));
+    }
+
+    double getParallelCellBytes() {
+        return getCellBytes(sizeof(ParallelCell));
+    }
+
+    double getConnectionBytes() {
+        return sizeof(CellConnection) + HEAP_BYTES + SHARED_BLOCK_BYTES + sizeof(std::shared_ptr<CellConnection>);
+    }
+
+}
+
+MemoryReport::MemoryReport() : _bytes(ITEMS_SIZE, 0.0) {}
+
+double MemoryReport::getTotal() const {
+    double total = 0.0;
+    for (auto bytes : _bytes) {
+        total += bytes;
+    }
+    return total;
+}
+
+std::vector<MemoryReport> MemoryReport::estimate(const Mesh* mesh, double meshTransferBytes) {
+    unsigned int partitionsSize = 1;
+    for (const auto& element : mesh->getElements()) {
+        if (element->isMain() == true) {
+            partitionsSize = std::max(partitionsSize, static_cast<unsigned int>(std::max(element->getProcessId() + 1, 1)));
+        }
+    }
+
+    // the same cells and connections as grid creates for each rank
+    std::vector<double> normalSizes(partitionsSize, 0.0), borderSizes(partitionsSize, 0.0), connectionsSizes(partitionsSize, 0.0);
+    std::vector<std::unordered_set<int>> parallelIds(partitionsSize);
+
+    // maxwellian tables are shared by cells of the same gas and temperature, temperatures are taken as grid does,
+    // gradients of initial temperatures aren't kept
+    auto config = Config::getInstance();
+    std::size_t gasesSize = config->getGases().size();
+    std::vector<std::set<std::pair<unsigned int, double>>> tablesKeys(partitionsSize);
+
+    // each sweep order goes for signs of impulse projections onto distinct face directions
+    std::set<std::tuple<long, long, long>> directions;
+    auto addTables = [&](unsigned int partition, const auto& parameters, const std::string& group, const Vector3d& center, bool isKeepingGradients) {
+        for (const auto& param : parameters) {
+            if (param.getGroup() == group) {
+                for (unsigned int gi = 0; gi < gasesSize; gi++) {
+                    if (param.hasGradientTemperature(gi) == false) {
+                        tablesKeys[partition].emplace(gi, param.getTemperature(gi));
+                    } else if (isKeepingGradients) {
+                        tablesKeys[partition].emplace(gi, param.getGradientTemperature(gi).getValue(center));
+                    }
+                }
+            }
+        }
+    };
+
+    for (const auto& element : mesh->getElements()) {
+        if (element->isMain() == false) {
+            continue;
+        }
+        unsigned int partition = static_cast<unsigned int>(std::max(element->getProcessId(), 0));
+        normalSizes[partition]++;
+        addTables(partition, config->getInitialParameters(), element->getGroup(), element->getCenter(), false);
+
+        for (const auto& sideElement : element->getSideElements()) {
+            Vector3d normal = sideElement->getNormal();
+            if (normal.x() < 0.0 || (normal.x() == 0.0 && (normal.y() < 0.0 || (normal.y() == 0.0 && normal.z() < 0.0)))) {
+                normal = -normal;
+            }
+            directions.emplace(std::lround(normal.x() * 1e6), std::lround(normal.y() * 1e6), std::lround(normal.z() * 1e6));
+
+            auto neighborElement = mesh->getElement(sideElement->getNeighborId());
+            if (neighborElement->isMain()) {
+                if (partitionsSize == 1 || neighborElement->getProcessId() == element->getProcessId()) {
+                    connectionsSizes[partition] += 1;
+                } else {
+                    parallelIds[partition].insert(neighborElement->getId());
+                    connectionsSizes[partition] += 2;
+                }
+            } else if (neighborElement->isBorder()) {
+                borderSizes[partition]++;
+                addTables(partition, config->getBoundaryParameters(), neighborElement->getGroup(), sideElement->getElement()->getCenter(), true);
+                connectionsSizes[partition] += 2;
+            }
+        }
+    }
+
+    double distributionBytes = getDistributionBytes();
+    double meshBytes = getMeshBytes(mesh);
+    double impulseSphereBytes = getImpulseSphereBytes();
+    double ordersSize = 0.0;
+    if (config->isImplicitScheme() || config->getSteadySolver() == "jfnk") {
+        double impulsesSize = config->getImpulseSphere()->getImpulses().size();
+        ordersSize = directions.size() < 31 ? std::min(std::pow(2.0, directions.size()), impulsesSize) : impulsesSize;
+    }
+    double collisionNodesBytes = 0.0;
+    if (Config::getInstance()->isUsingIntegral()) {
+        collisionNodesBytes = getVectorBytes(static_cast<std::size_t>(COLLISION_NODES_SIZE), sizeof(ci::node_calc));
+    }
+
+    std::vector<MemoryReport> reports(partitionsSize);
+    for (unsigned int partition = 0; partition < partitionsSize; partition++) {
+        auto& report = reports[partition];
+        double parallelSize = parallelIds[partition].size();
+        double cellsSize = normalSizes[partition] + borderSizes[partition] + parallelSize;
+
+        report.add(Item::VALUES, cellsSize * distributionBytes);
+        report.add(Item::NEW_VALUES, normalSizes[partition] * distributionBytes);
+        report.add(Item::MAXWELLIAN_TABLES, tablesKeys[partition].size() * getMaxwellianTableBytes());
+        report.add(Item::BORDER_INDEXES, borderSizes[partition] * getBorderIndexesBytes());
+        if (ordersSize > 0.0) {
+            report.add(Item::SWEEP_ORDERS, ordersSize * getVectorBytes(static_cast<std::size_t>(normalSizes[partition]), sizeof(unsigned int)) +
+                                           getSweepGroupsBytes(ordersSize));
+        }
+        report.add(Item::CELLS, normalSizes[partition] * getNormalCellBytes() +
+                                borderSizes[partition] * getBorderCellBytes() +
+                                parallelSize * getParallelCellBytes());
+        report.add(Item::CONNECTIONS, connectionsSizes[partition] * getConnectionBytes());
+        report.add(Item::MESH, meshBytes);
+        if (partitionsSize > 1) {
+            report.add(Item::MESH_TRANSFER, meshTransferBytes);
+        }
+        report.add(Item::IMPULSE_SPHERE, impulseSphereBytes);
+        report.add(Item::COLLISION_NODES, collisionNodesBytes);
+    }
+    return reports;
+}
+
+MemoryReport MemoryReport::count(const Grid* grid, double meshTransferBytes) {
+    MemoryReport report;
+
+    double connectionsSize = 0.0;
+    for (const auto& cell : grid->getCells()) {
+        report.add(Item::VALUES, getVectorBytes(cell->getValues()));
+        connectionsSize += cell->getConnections().size();
+    }
+    for (auto cell : grid->getNormalCells()) {
+        report.add(Item::NEW_VALUES, getVectorBytes(cell->getNewValues()));
+    }
+    for (auto cell : grid->getBorderCells()) {
+        report.add(Item::BORDER_INDEXES, getVectorBytes(cell->getInwardIndexes().capacity(), sizeof(unsigned int)) +
+                                         getVectorBytes(cell->getInwardProjections().capacity(), sizeof(double)) +
+                                         getVectorBytes(cell->getOutwardIndexes().capacity(), sizeof(unsigned int)) +
+                                         getVectorBytes(cell->getOutwardProjections().capacity(), sizeof(double)) +
+                                         getVectorBytes(cell->getMirrorIndexes().capacity(), sizeof(int)));
+    }
+
+    report.add(Item::MAXWELLIAN_TABLES, grid->getMaxwellianCache()->getTables().size() * getMaxwellianTableBytes());
+
+    auto sweepSchedule = grid->getSweepSchedule();
+    if (sweepSchedule != nullptr) {
+        for (const auto& order : sweepSchedule->getOrders()) {
+            report.add(Item::SWEEP_ORDERS, getVectorBytes(order.capacity(), sizeof(unsigned int)));
+        }
+        report.add(Item::SWEEP_ORDERS, getVectorBytes(grid->getNormalCells().size(), sizeof(NormalCell*)) +
+                                       getSweepGroupsBytes(sweepSchedule->getGroups().size()));
+    }
+
+    report.add(Item::CELLS, grid->getNormalCells().size() * getNormalCellBytes() +
+                            grid->getBorderCells().size() * getBorderCellBytes() +
+                            grid->getParallelCells().size() * getParallelCellBytes());
+    report.add(Item::CONNECTIONS, connectionsSize * getConnectionBytes());
+    report.add(Item::MESH, getMeshBytes(grid->getMesh()));
+    report.add(Item::MESH_TRANSFER, meshTransferBytes);
+    report.add(Item::IMPULSE_SPHERE, getImpulseSphereBytes());
+
+    // collision nodes are allocated on first ci::gen, so they are predicted here too
+    if (Config::getInstance()->isUsingIntegral()) {
+        auto capacity = std::max(ci::nc.capacity(), static_cast<std::size_t>(COLLISION_NODES_SIZE));
+        report.add(Item::COLLISION_NODES, getVectorBytes(capacity, sizeof(ci::node_calc)));
+    }
+    return report;
+}
+
+void MemoryReport::printEstimate(const std::vector<MemoryReport>& reports) {
+    std::vector<double> minBytes(ITEMS_SIZE + 1, std::numeric_limits<double>::max());
+    std::vector<double> meanBytes(ITEMS_SIZE + 1, 0.0), maxBytes(ITEMS_SIZE + 1, 0.0);
+    for (const auto& report : reports) {
+        std::vector<double> bytes = report._bytes;
+        bytes.push_back(report.getTotal());
+        for (unsigned int ii = 0; ii < bytes.size(); ii++) {
+            minBytes[ii] = std::min(minBytes[ii], bytes[ii]);
+            meanBytes[ii] += bytes[ii] / reports.size();
+            maxBytes[ii] = std::max(maxBytes[ii], bytes[ii]);
+        }
+    }
+    print("Memory estimate", reports.size(), minBytes, meanBytes, maxBytes);
+}
+
+void MemoryReport::print() const {
+    double residentBytes = 0.0, peakResidentBytes = 0.0;
+    getResidentBytes(residentBytes, peakResidentBytes);
+
+    std::vector<double> bytes = _bytes;
+    bytes.push_back(getTotal());
+    bytes.push_back(residentBytes);
+    bytes.push_back(peakResidentBytes);
+
+    std::vector<double> minBytes = bytes, maxBytes = bytes, sumBytes = bytes;
+    if (Parallel::isSingle() == false) {
+        minBytes = Parallel::allReduce(bytes, Parallel::Reduce::MIN);
+        maxBytes = Parallel::allReduce(bytes, Parallel::Reduce::MAX);
+        sumBytes = Parallel::allReduce(bytes, Parallel::Reduce::SUM);
+    }
+
+    std::vector<double> meanBytes(sumBytes.size());
+    for (unsigned int ii = 0; ii < sumBytes.size(); ii++) {
+        meanBytes[ii] = sumBytes[ii] / Parallel::getSize();
+    }
+    print("Memory usage", Parallel::getSize(), minBytes, meanBytes, maxBytes);
+}
+
+const char* MemoryReport::getItemName(Item item) {
+    switch (item) {
+        case Item::VALUES:
+            return "values";
+        case Item::NEW_VALUES:
+            return "new_values";
+        case Item::MAXWELLIAN_TABLES:
+            return "maxwellian_tables";
+        case Item::BORDER_INDEXES:
+            return "border_indexes";
+        case Item::SWEEP_ORDERS:
+            return "sweep_orders";
+        case Item::CELLS:
+            return "cells";
+        case Item::CONNECTIONS:
+            return "connections";
+        case Item::MESH:
+            return "mesh";
+        case Item::MESH_TRANSFER:
+            return "mesh_transfer";
+        case Item::IMPULSE_SPHERE:
+            return "impulse_sphere";
+        case Item::COLLISION_NODES:
+            return "collision_nodes";
+    }
+    return "unknown";
+}
+
+double MemoryReport::getMeshBytes(const Mesh* mesh) {
+    double bytes = 0.0;
+    bytes += mesh->getPhysicalEntities().size() * (sizeof(PhysicalEntity) + HEAP_BYTES + SHARED_BLOCK_BYTES +
+             sizeof(std::shared_ptr<PhysicalEntity>) + MAP_NODE_BYTES + sizeof(std::pair<const int, PhysicalEntity*>));
+    bytes += mesh->getNodes().size() * (sizeof(Node) + HEAP_BYTES + SHARED_BLOCK_BYTES +
+             sizeof(std::shared_ptr<Node>) + MAP_NODE_BYTES + sizeof(std::pair<const int, Node*>));
+    for (const auto& element : mesh->getElements()) {
+        bytes += getElementBytes(element.get()) + SHARED_BLOCK_BYTES + sizeof(std::shared_ptr<Element>) +
+                 MAP_NODE_BYTES + sizeof(std::pair<const int, Element*>);
+    }
+    return bytes;
+}
+
+double MemoryReport::getElementBytes(const Element* element) {
+    double bytes = sizeof(Element) + HEAP_BYTES;
+    bytes += getVectorBytes(element->getPartitions().capacity(), sizeof(int));
+    bytes += getVectorBytes(element->getNodeIds().capacity(), sizeof(int));
+
+    // short groups names are stored inside of string
+    if (element->getGroup().capacity() > 15) {
+        bytes += element->getGroup().capacity() + 1 + HEAP_BYTES;
+    }
+
+    const auto& sideElements = element->getSideElements();
+    bytes += getVectorBytes(sideElements.capacity(), sizeof(std::shared_ptr<ElementBorder>));
+    for (const auto& sideElement : sideElements) {
+        bytes += sizeof(ElementBorder) + HEAP_BYTES + SHARED_BLOCK_BYTES;
+        bytes += getElementBytes(sideElement->getElement().get()) + SHARED_BLOCK_BYTES;
+    }
+    return bytes;
+}
+
+double MemoryReport::getImpulseSphereBytes() {
+    auto impulseSphere = Config::getInstance()->getImpulseSphere();
+    double resolution = impulseSphere->getResolution();
+    return getVectorBytes(impulseSphere->getImpulses().capacity(), sizeof(Vector3d)) +
+           resolution * resolution * (resolution * sizeof(int) + HEAP_BYTES) +
+           resolution * (resolution * sizeof(int*) + HEAP_BYTES) +
+           resolution * sizeof(int**) + HEAP_BYTES;
+}
+
+double MemoryReport::getDistributionBytes() {
+    auto config = Config::getInstance();
+    std::size_t gasesSize = config->getGases().size();
+    std::size_t impulsesSize = config->getImpulseSphere()->getImpulses().size();
+    return getVectorBytes(gasesSize, sizeof(std::vector<double>)) + gasesSize * getVectorBytes(impulsesSize, sizeof(double));
+}
+
+double MemoryReport::getBorderIndexesBytes() {
+    std::size_t impulsesSize = Config::getInstance()->getImpulseSphere()->getImpulses().size();
+    return impulsesSize * (sizeof(unsigned int) + sizeof(double)) + 4 * HEAP_BYTES;
+}
+
+void MemoryReport::print(const std::string& title, unsigned int ranks,
+                         const std::vector<double>& minBytes, const std::vector<double>& meanBytes, const std::vector<double>& maxBytes) {
+    if (Parallel::isMaster() == false) {
+        return;
+    }
+
+    const double MB = 1024.0 * 1024.0;
+    auto printRow = [&](std::stringstream& ss, const std::string& name, unsigned int ii) {
+        ss << std::left << std::setw(18) << name
+           << std::right << std::fixed << std::setprecision(1)
+           << std::setw(12) << minBytes[ii] / MB
+           << std::setw(12) << meanBytes[ii] / MB
+           << std::setw(12) << maxBytes[ii] / MB;
+        if (ii <= ITEMS_SIZE) {
+            ss << std::setw(9) << (meanBytes[ITEMS_SIZE] > 0.0 ? 100.0 * meanBytes[ii] / meanBytes[ITEMS_SIZE] : 0.0) << "%";
+        }
+        ss << std::endl;
+    };
+
+    std::stringstream ss;
+    ss << std::endl << title << " (MB per rank, " << ranks << " ranks):" << std::endl;
+    ss << std::left << std::setw(18) << "structure"
+       << std::right << std::setw(12) << "min"
+       << std::setw(12) << "mean"
+       << std::setw(12) << "max"
+       << std::setw(10) << "share" << std::endl;
+    for (unsigned int ii = 0; ii < ITEMS_SIZE; ii++) {
+        if (maxBytes[ii] == 0.0) {
+            continue;
+        }
+        printRow(ss, getItemName(static_cast<Item>(ii)), ii);
+    }
+    printRow(ss, "total", ITEMS_SIZE);
+
+    // live report has resident memory of processes after total
+    if (minBytes.size() > ITEMS_SIZE + 1) {
+        printRow(ss, "resident", ITEMS_SIZE + 1);
+        printRow(ss, "peak_resident", ITEMS_SIZE + 2);
+    }
+    std::cout << ss.str() << std::endl;
+    std::cout.flush();
+}
+
+void MemoryReport::getResidentBytes(double& residentBytes, double& peakResidentBytes) {
+    residentBytes = 0.0;
+    peakResidentBytes = 0.0;
+
+    std::ifstream fs("/proc/self/status");
+    std::string line;
+    while (std::getline(fs, line)) {
+        std::istringstream is(line);
+        std::string key;
+        double kilobytes = 0.0;
+        is >> key >> kilobytes;
+        if (key == "VmRSS:") {
+            residentBytes = kilobytes * 1024.0;
+        } else if (key == "VmHWM:") {
+            peakResidentBytes = kilobytes * 1024.0;
+        }
+    }
+}
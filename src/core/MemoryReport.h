@@ -0,0 +1,83 @@
+#ifndef RGS_MEMORYREPORT_H
+#define RGS_MEMORYREPORT_H
+
+#include <string>
+#include <vector>
+
+class Grid;
+class Mesh;
+class Element;
+
+// Bytes held by main solver structures on one rank.
+// Estimate is predicted from mesh partitions without allocating any distributions,
+// count is taken from live grid after initialization.
+class MemoryReport {
+public:
+    enum class Item {
+        VALUES,             // distribution functions of all cells
+        NEW_VALUES,         // next step distribution functions of normal cells
+        MAXWELLIAN_TABLES,  // maxwellian exponents shared by normal and border cells
+        BORDER_INDEXES,     // half space impulse lists and mirror indexes of border cells
+        SWEEP_ORDERS,       // upwind orders of cells of implicit sweeps
+        CELLS,              // cell objects, parameters and lookup maps
+        CONNECTIONS,        // cell connections with shared pointers
+        MESH,               // whole mesh, kept on each rank
+        MESH_TRANSFER,      // serialized mesh, freed after initialization
+        IMPULSE_SPHERE,     // impulses and xyz to index map
+        COLLISION_NODES     // ci::nc
+    };
+
+    static const unsigned int ITEMS_SIZE = static_cast<unsigned int>(Item::COLLISION_NODES) + 1;
+
+private:
+    std::vector<double> _bytes;
+
+public:
+    MemoryReport();
+
+    void add(Item item, double bytes) {
+        _bytes[static_cast<unsigned int>(item)] += bytes;
+    }
+
+    double get(Item item) const {
+        return _bytes[static_cast<unsigned int>(item)];
+    }
+
+    double getTotal() const;
+
+    // one report for each mesh partition, mesh must be initialized
+    static std::vector<MemoryReport> estimate(const Mesh* mesh, double meshTransferBytes);
+
+    // own rank only, meshTransferBytes is size of received or sent serialized mesh
+    static MemoryReport count(const Grid* grid, double meshTransferBytes);
+
+    // prints min/mean/max over estimated partitions
+    static void printEstimate(const std::vector<MemoryReport>& reports);
+
+    // collective, prints min/mean/max over ranks with resident memory of processes
+    void print() const;
+
+    static const char* getItemName(Item item);
+
+private:
+    static double getMeshBytes(const Mesh* mesh);
+
+    static double getElementBytes(const Element* element);
+
+    static double getImpulseSphereBytes();
+
+    // value and heap bytes of per gas vectors with impulses size each
+    static double getDistributionBytes();
+
+    // inward and outward impulses with projections of one border cell, no mirror indexes
+    static double getBorderIndexesBytes();
+
+    static void print(const std::string& title, unsigned int ranks,
+                      const std::vector<double>& minBytes, const std::vector<double>& meanBytes, const std::vector<double>& maxBytes);
+
+    // VmRSS and VmHWM of current process, zero where /proc is not available
+    static void getResidentBytes(double& residentBytes, double& peakResidentBytes);
+
+};
+
+#endif //RGS_MEMORYREPORT_H
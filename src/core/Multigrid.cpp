@@ -0,0 +1,463 @@
+#include "Multigrid.h"
+#include "Config.h"
+#include "grid/Grid.h"
+#include "grid/GridBuffer.h"
+#include "grid/NormalCell.h"
+#include "grid/BorderCell.h"
+#include "grid/CellConnection.h"
+#include "utilities/Parallel.h"
+#include "utilities/Profiler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+
+Multigrid::Multigrid(Grid* grid, const std::function<void()>& advance) : _grid(grid), _advance(advance), _stepsSize(0) {
+    auto config = Config::getInstance();
+    if (config->isUsingMultirateTimestep()) {
+        throw std::runtime_error("multigrid goes with single rate timestep only");
+    }
+    if (config->getMultigridCycle() != "V" && config->getMultigridCycle() != "W") {
+        throw std::runtime_error("unknown multigrid cycle: " + config->getMultigridCycle());
+    }
+    if (config->getMultigridSmoothingSteps() == 0 || config->getMultigridFineSteps() == 0) {
+        throw std::runtime_error("multigrid smoothing steps must be positive");
+    }
+
+    Level finest;
+    finest.normalCells = _grid->getNormalCells();
+    _levels.push_back(finest);
+
+    _minStep = std::numeric_limits<double>::max();
+    for (const auto& normalCell : finest.normalCells) {
+        _minStep = std::min(_minStep, getStep(normalCell));
+    }
+    if (Parallel::isSingle() == false) {
+        _minStep = Parallel::allReduce({_minStep}, Parallel::Reduce::MIN)[0];
+    }
+
+    while (_levels.size() <= config->getMultigridLevels() && addLevel()) {}
+
+    std::vector<double> sizes;
+    for (const auto& level : _levels) {
+        sizes.push_back(level.normalCells.size());
+    }
+    if (Parallel::isSingle() == false) {
+        sizes = Parallel::allReduce(sizes, Parallel::Reduce::SUM);
+    }
+    if (Parallel::isMaster()) {
+        std::cout << "Multigrid levels = " << _levels.size() << "; cells =";
+        for (auto size : sizes) {
+            std::cout << " " << size;
+        }
+        std::cout << std::endl;
+    }
+}
+
+void Multigrid::step() {
+
+    // coarse steps take collision nodes of fine step
+    _grid->setCollisionsFrozen(true);
+
+    if (_grid->isClosed() && _masses.empty()) {
+        _masses = _grid->computeMasses();
+    }
+
+    // fine steps smooth values between cycles, last one gives residual
+    _stepsSize++;
+    bool isCycle = _levels.size() > 1 && _stepsSize % Config::getInstance()->getMultigridFineSteps() == 0;
+    std::vector<double> prevValues;
+    if (isCycle) {
+        prevValues = _grid->getNormalValues();
+    }
+    _advance();
+    if (isCycle) {
+        correct(0, prevValues);
+    }
+
+    // forcing of coarse steps isn't conservative with local timesteps
+    if (_masses.empty() == false) {
+        _grid->scaleMasses(_masses);
+    }
+
+    _grid->setCollisionsFrozen(false);
+    _grid->check();
+}
+
+bool Multigrid::addLevel() {
+    auto config = Config::getInstance();
+    const auto& fineCells = _levels.back().normalCells;
+
+    std::unordered_map<BaseCell*, unsigned int> indexes;
+    for (unsigned int ci = 0; ci < fineCells.size(); ci++) {
+        indexes[fineCells[ci]] = ci;
+    }
+
+    // neighbors on the same rank and level with squares of faces
+    auto getNeighbors = [&](unsigned int ci) {
+        std::vector<std::pair<unsigned int, double>> neighbors;
+        for (const auto& connection : fineCells[ci]->getConnections()) {
+            auto index = indexes.find(connection->getSecond());
+            if (index != indexes.end()) {
+                neighbors.emplace_back(index->second, connection->getSquare());
+            }
+        }
+        return neighbors;
+    };
+
+    // cells go in breadth first order, so each free cell takes free neighbors and agglomerates stay compact
+    const unsigned int NONE = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> parents(fineCells.size(), NONE);
+    std::vector<unsigned int> parentsSizes;
+    std::vector<bool> isVisited(fineCells.size(), false);
+    for (unsigned int start = 0; start < fineCells.size(); start++) {
+        if (isVisited[start]) {
+            continue;
+        }
+        std::queue<unsigned int> queue;
+        queue.push(start);
+        isVisited[start] = true;
+        while (queue.empty() == false) {
+            auto ci = queue.front();
+            queue.pop();
+            auto neighbors = getNeighbors(ci);
+            if (parents[ci] == NONE) {
+                parents[ci] = parentsSizes.size();
+                parentsSizes.push_back(1);
+
+                // only neighbors over large faces, so flat cells go together across short side
+                double maxSquare = 0.0;
+                for (const auto& neighbor : neighbors) {
+                    maxSquare = std::max(maxSquare, neighbor.second);
+                }
+                for (const auto& neighbor : neighbors) {
+                    if (parents[neighbor.first] == NONE && neighbor.second >= 0.5 * maxSquare) {
+                        parents[neighbor.first] = parents[ci];
+                        parentsSizes.back()++;
+                    }
+                }
+            }
+            for (const auto& neighbor : neighbors) {
+                if (isVisited[neighbor.first] == false) {
+                    isVisited[neighbor.first] = true;
+                    queue.push(neighbor.first);
+                }
+            }
+        }
+    }
+
+    // single cells join neighbor agglomerate over largest face
+    for (unsigned int ci = 0; ci < fineCells.size(); ci++) {
+        if (parentsSizes[parents[ci]] != 1) {
+            continue;
+        }
+        unsigned int best = NONE;
+        double bestSquare = 0.0;
+        for (const auto& neighbor : getNeighbors(ci)) {
+            if (neighbor.second > bestSquare) {
+                best = neighbor.first;
+                bestSquare = neighbor.second;
+            }
+        }
+        if (best != NONE) {
+            parentsSizes[parents[ci]] = 0;
+            parents[ci] = parents[best];
+            parentsSizes[parents[ci]]++;
+        }
+    }
+    std::vector<unsigned int> renumbers(parentsSizes.size(), NONE);
+    unsigned int coarseSize = 0;
+    for (auto& parent : parents) {
+        if (renumbers[parent] == NONE) {
+            renumbers[parent] = coarseSize++;
+        }
+        parent = renumbers[parent];
+    }
+
+    // level is useless when cells don't go less
+    std::vector<double> sizes = {double(fineCells.size()), double(coarseSize)};
+    if (Parallel::isSingle() == false) {
+        sizes = Parallel::allReduce(sizes, Parallel::Reduce::SUM);
+    }
+    if (sizes[1] > 0.75 * sizes[0]) {
+        return false;
+    }
+
+    Level level;
+    level.buffer.reset(new GridBuffer());
+    level.parents = parents;
+
+    std::vector<double> volumes(coarseSize, 0.0);
+    std::vector<NormalCell*> firstCells(coarseSize, nullptr);
+    for (unsigned int ci = 0; ci < fineCells.size(); ci++) {
+        volumes[parents[ci]] += fineCells[ci]->getVolume();
+        if (firstCells[parents[ci]] == nullptr) {
+            firstCells[parents[ci]] = fineCells[ci];
+        }
+    }
+    for (unsigned int pi = 0; pi < coarseSize; pi++) {
+        auto normalCell = new NormalCell(firstCells[pi]->getId(), volumes[pi], _grid->getMaxwellianCache());
+        normalCell->getParams() = firstCells[pi]->getParams();
+        level.cells.emplace_back(normalCell);
+        level.normalCells.push_back(normalCell);
+    }
+
+    // faces inside agglomerates are dropped, coplanar faces with the same neighbor or border group are merged,
+    // border cells are copied for coarse cells, parallel cells are the same for all levels
+    struct Face {
+        BaseCell* neighbor;         // coarse normal or parallel cell, first fine border cell of border face
+        double square;
+        Vector3d normal;
+    };
+    std::vector<std::vector<Face>> faces(coarseSize);
+    auto isSameFace = [](const Face& face, BaseCell* neighbor, const Vector3d& normal) {
+        if (face.normal.scalar(normal) < 1.0 - 1e-6) {
+            return false;
+        }
+        if (face.neighbor->getType() == BaseCell::Type::BORDER && neighbor->getType() == BaseCell::Type::BORDER) {
+            return dynamic_cast<BorderCell*>(face.neighbor)->getGroup() == dynamic_cast<BorderCell*>(neighbor)->getGroup();
+        }
+        return face.neighbor == neighbor;
+    };
+    for (unsigned int ci = 0; ci < fineCells.size(); ci++) {
+        auto coarseCell = level.normalCells[parents[ci]];
+        auto& cellFaces = faces[parents[ci]];
+        for (const auto& connection : fineCells[ci]->getConnections()) {
+            auto neighbor = connection->getSecond();
+            auto index = indexes.find(neighbor);
+            if (index != indexes.end()) {
+                neighbor = level.normalCells[parents[index->second]];
+                if (neighbor == coarseCell) {
+                    continue;
+                }
+            }
+            const auto& normal = connection->getNormal12();
+            auto face = std::find_if(cellFaces.begin(), cellFaces.end(), [&](const Face& face) {
+                return isSameFace(face, neighbor, normal);
+            });
+            if (face != cellFaces.end()) {
+                face->square += connection->getSquare();
+            } else {
+                cellFaces.push_back({neighbor, connection->getSquare(), normal});
+            }
+        }
+    }
+    for (unsigned int pi = 0; pi < coarseSize; pi++) {
+        auto coarseCell = level.normalCells[pi];
+        for (const auto& face : faces[pi]) {
+            auto neighbor = face.neighbor;
+            if (neighbor->getType() == BaseCell::Type::BORDER) {
+                auto fineBorderCell = dynamic_cast<BorderCell*>(neighbor);
+                auto borderCell = new BorderCell(fineBorderCell->getId(), level.buffer.get(), _grid->getMaxwellianCache());
+                for (unsigned int gi = 0; gi < config->getGases().size(); gi++) {
+                    borderCell->setBorderType(gi, fineBorderCell->getBorderType(gi));
+                }
+                borderCell->getBoundaryParams() = fineBorderCell->getBoundaryParams();
+                borderCell->setConnectParams(fineBorderCell->getGroup(), fineBorderCell->getGroupConnect());
+                level.cells.emplace_back(borderCell);
+                level.borderCells.push_back(borderCell);
+
+                borderCell->addConnection(new CellConnection(borderCell, coarseCell, face.square, -face.normal));
+                neighbor = borderCell;
+            }
+            coarseCell->addConnection(new CellConnection(coarseCell, neighbor, face.square, face.normal));
+        }
+    }
+
+    for (const auto& cell : level.cells) {
+        cell->init();
+    }
+
+    // coarse cells are as stable with longer timestep as the least finest cell with global one
+    for (const auto& normalCell : level.normalCells) {
+        normalCell->setTimestepScale(std::max(getStep(normalCell) / _minStep, 1.0));
+    }
+
+    _levels.push_back(std::move(level));
+    return true;
+}
+
+void Multigrid::cycle(unsigned int level) {
+    auto steps = Config::getInstance()->getMultigridSmoothingSteps();
+    bool isCoarsest = level + 1 == _levels.size();
+
+    // last pre smoothing step gives residual for coarser level
+    std::vector<double> prevValues;
+    for (unsigned int si = 0; si < steps; si++) {
+        if (si + 1 == steps && isCoarsest == false) {
+            prevValues = getValues(level);
+        }
+        smooth(level);
+    }
+
+    if (isCoarsest == false) {
+        correct(level, prevValues);
+        for (unsigned int si = 0; si < steps; si++) {
+            smooth(level);
+        }
+    }
+}
+
+void Multigrid::correct(unsigned int level, const std::vector<double>& prevValues) {
+    auto config = Config::getInstance();
+    const auto& fineCells = _levels[level].normalCells;
+    auto& coarse = _levels[level + 1];
+    auto blockSize = config->getGases().size() * config->getImpulseSphere()->getImpulses().size();
+    auto timestep = config->getTimestep();
+
+    // values before step and their residual go to coarse cells by volume
+    auto values = getValues(level);
+    std::vector<double> coarseValues(coarse.normalCells.size() * blockSize, 0.0);
+    std::vector<double> coarseResiduals(coarseValues.size(), 0.0);
+    for (unsigned int ci = 0; ci < fineCells.size(); ci++) {
+        double volume = fineCells[ci]->getVolume();
+        double rate = volume / (timestep * fineCells[ci]->getTimestepScale());
+        const double* cellValues = &values[ci * blockSize];
+        const double* cellPrevValues = &prevValues[ci * blockSize];
+        double* parentValues = &coarseValues[coarse.parents[ci] * blockSize];
+        double* parentResiduals = &coarseResiduals[coarse.parents[ci] * blockSize];
+        for (unsigned int i = 0; i < blockSize; i++) {
+            parentValues[i] += cellPrevValues[i] * volume;
+            parentResiduals[i] += (cellValues[i] - cellPrevValues[i]) * rate;
+        }
+    }
+    for (unsigned int pi = 0; pi < coarse.normalCells.size(); pi++) {
+        double volume = coarse.normalCells[pi]->getVolume();
+        for (unsigned int i = pi * blockSize; i < (pi + 1) * blockSize; i++) {
+            coarseValues[i] /= volume;
+            coarseResiduals[i] /= volume;
+        }
+    }
+
+    // forcing is coarse residual of restricted values less restricted fine residual,
+    // so coarse step of restricted values goes as fine one, first step is done by the way
+    coarse.forcing.clear();
+    setValues(level + 1, coarseValues);
+    smooth(level + 1);
+    auto forcing = getValues(level + 1);
+    auto startValues = coarseValues;
+    for (unsigned int pi = 0; pi < coarse.normalCells.size(); pi++) {
+        double coarseTimestep = timestep * coarse.normalCells[pi]->getTimestepScale();
+        for (unsigned int i = pi * blockSize; i < (pi + 1) * blockSize; i++) {
+            forcing[i] = (forcing[i] - coarseValues[i]) / coarseTimestep - coarseResiduals[i];
+            startValues[i] = std::max(coarseValues[i] + coarseResiduals[i] * coarseTimestep, 0.0);
+        }
+    }
+    coarse.forcing = std::move(forcing);
+    setValues(level + 1, startValues);
+
+    unsigned int cyclesSize = config->getMultigridCycle() == "W" ? 2 : 1;
+    for (unsigned int ci = 0; ci < cyclesSize; ci++) {
+        cycle(level + 1);
+    }
+
+    // coarse change goes to each fine cell of agglomerate damped, piecewise constant change
+    // overshoots in cells far from agglomerate center, values stay non negative
+    double damping = config->getMultigridCorrectionDamping();
+    auto newCoarseValues = getValues(level + 1);
+    for (unsigned int ci = 0; ci < fineCells.size(); ci++) {
+        double* cellValues = &values[ci * blockSize];
+        const double* parentValues = &coarseValues[coarse.parents[ci] * blockSize];
+        const double* newParentValues = &newCoarseValues[coarse.parents[ci] * blockSize];
+        for (unsigned int i = 0; i < blockSize; i++) {
+            cellValues[i] = std::max(cellValues[i] + damping * (newParentValues[i] - parentValues[i]), 0.0);
+        }
+    }
+    setValues(level, values);
+}
+
+void Multigrid::smooth(unsigned int level) {
+    auto config = Config::getInstance();
+    auto& coarse = _levels[level];
+
+    computeTransfer(coarse);
+
+    if (config->isUsingIntegral()) {
+        for (const auto& pair : config->getCollisionPairs()) {
+            _grid->prepareCollisions(pair.first, pair.second);
+
+            ScopedTimer timer(Profiler::Phase::CELL_OPERATORS);
+            for (const auto& cell : coarse.normalCells) {
+                cell->computeIntegral(pair.first, pair.second);
+            }
+        }
+    }
+
+    if (config->isUsingBetaDecay()) {
+        ScopedTimer timer(Profiler::Phase::CELL_OPERATORS);
+        for (const auto& betaChain : config->getBetaChains()) {
+            for (const auto& cell : coarse.normalCells) {
+                cell->computeBetaDecay(betaChain.getGasIndex1(), betaChain.getGasIndex2(), betaChain.getLambda1());
+                cell->computeBetaDecay(betaChain.getGasIndex2(), betaChain.getGasIndex3(), betaChain.getLambda2());
+            }
+        }
+    }
+
+    computeTransfer(coarse);
+
+    if (coarse.forcing.empty()) {
+        return;
+    }
+    auto values = getValues(level);
+    auto blockSize = values.size() / std::max<size_t>(coarse.normalCells.size(), 1);
+    for (unsigned int ci = 0; ci < coarse.normalCells.size(); ci++) {
+        double timestep = config->getTimestep() * coarse.normalCells[ci]->getTimestepScale();
+        for (unsigned int i = ci * blockSize; i < (ci + 1) * blockSize; i++) {
+            values[i] = std::max(values[i] - coarse.forcing[i] * timestep, 0.0);
+        }
+    }
+    setValues(level, values);
+}
+
+void Multigrid::computeTransfer(Level& level) {
+    level.buffer->clearAllFlows();
+    {
+        ScopedTimer timer(Profiler::Phase::BORDER);
+        for (const auto& cell : level.borderCells) {
+            cell->computeTransfer();
+        }
+    }
+    {
+        ScopedTimer timer(Profiler::Phase::AVERAGE_FLOW);
+        level.buffer->calculateAverageFlow();
+    }
+
+    ScopedTimer timer(Profiler::Phase::TRANSFER);
+    for (const auto& cell : level.normalCells) {
+        cell->computeTransfer();
+    }
+    for (const auto& cell : level.normalCells) {
+        cell->swapValues();
+    }
+}
+
+double Multigrid::getStep(NormalCell* normalCell) {
+    double square = 0.0;
+    for (const auto& connection : normalCell->getConnections()) {
+        square += connection->getSquare();
+    }
+    return normalCell->getVolume() / square;
+}
+
+std::vector<double> Multigrid::getValues(unsigned int level) const {
+    std::vector<double> values;
+    for (const auto& cell : _levels[level].normalCells) {
+        for (const auto& gasValues : cell->getValues()) {
+            values.insert(values.end(), gasValues.begin(), gasValues.end());
+        }
+    }
+    return values;
+}
+
+void Multigrid::setValues(unsigned int level, const std::vector<double>& values) {
+    auto value = values.begin();
+    for (const auto& cell : _levels[level].normalCells) {
+        for (auto& gasValues : cell->getValues()) {
+            std::copy(value, value + gasValues.size(), gasValues.begin());
+            value += gasValues.size();
+        }
+    }
+}
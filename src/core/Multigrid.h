@@ -0,0 +1,73 @@
+#ifndef RGS_MULTIGRID_H
+#define RGS_MULTIGRID_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Grid;
+class GridBuffer;
+class BaseCell;
+class NormalCell;
+class BorderCell;
+
+// Full approximation scheme multigrid towards steady state. Coarse cells are agglomerates of
+// neighbor normal cells of finer level, they go with the same transfer, collisions and decay
+// but with own longer local timesteps. Residual is change of values by step over timestep,
+// coarse level steps are pushed by forcing, so restricted steady values stay steady there.
+// Ranks are not agglomerated together, parallel cells keep values of last sync on coarse levels.
+class Multigrid {
+private:
+    struct Level {
+        std::vector<std::shared_ptr<BaseCell>> cells;   // own normal and border cells, none for finest level
+        std::vector<NormalCell*> normalCells;
+        std::vector<BorderCell*> borderCells;
+        std::shared_ptr<GridBuffer> buffer;
+        std::vector<unsigned int> parents;      // cell of this level for each cell of finer level
+        std::vector<double> forcing;            // rate subtracted from steps, empty is zero
+    };
+
+    Grid* _grid;
+    std::function<void()> _advance;     // one solver step without check
+    std::vector<Level> _levels;
+    std::vector<double> _masses;        // of each gas, kept on closed grid
+    double _minStep;                    // least volume to faces square of finest cells over ranks, coarse timesteps go from it
+    unsigned int _stepsSize;            // fine steps done
+
+public:
+    // collective
+    Multigrid(Grid* grid, const std::function<void()>& advance);
+
+    // collective, fine step with coarse correction cycle after each few ones
+    void step();
+
+    unsigned int getLevelsSize() const {
+        return _levels.size();
+    }
+
+private:
+    // agglomerates cells of last level, returns false when cells don't go less over all ranks
+    bool addLevel();
+
+    // coarse level cycle: pre smoothing, correction by coarser level, post smoothing
+    void cycle(unsigned int level);
+
+    // corrects values of level after step from given values by coarser level
+    void correct(unsigned int level, const std::vector<double>& prevValues);
+
+    // one step of coarse level with forcing
+    void smooth(unsigned int level);
+
+    void computeTransfer(Level& level);
+
+    // volume to square of all faces, stable timestep goes with it
+    static double getStep(NormalCell* normalCell);
+
+    // values of level cells, gas and impulse go inside
+    std::vector<double> getValues(unsigned int level) const;
+
+    void setValues(unsigned int level, const std::vector<double>& values);
+
+};
+
+#endif //RGS_MULTIGRID_H
@@ -0,0 +1,204 @@
+#include "NewtonSolver.h"
+#include "Config.h"
+#include "grid/Grid.h"
+#include "grid/NormalCell.h"
+#include "utilities/Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+NewtonSolver::NewtonSolver(Grid* grid, const std::function<void()>& advance)
+: _grid(grid), _advance(advance), _initialNorm(0.0), _norm(0.0) {}
+
+bool NewtonSolver::step() {
+    auto config = Config::getInstance();
+
+    // residual is smooth only while collisions go with the same nodes
+    _grid->setCollisionsFrozen(true);
+
+    auto values = _grid->getNormalValues();
+    if (_grid->isClosed() && _masses.empty()) {
+        _masses = _grid->computeMasses();
+    }
+    auto residual = computeResidual(values);
+    _norm = norm(residual);
+    if (_initialNorm == 0.0) {
+        _initialNorm = _norm;
+    }
+
+    unsigned int iterations = 0;
+    auto delta = solve(values, residual, iterations);
+
+    // backtracking keeps values non negative and residual decreasing, plain step goes when it fails
+    std::vector<double> newValues(values.size());
+    double lambda = 1.0;
+    bool isAccepted = false;
+    for (unsigned int bi = 0; bi < 4 && isAccepted == false; bi++) {
+        for (unsigned int i = 0; i < values.size(); i++) {
+            newValues[i] = std::max(values[i] + lambda * delta[i], 0.0);
+        }
+        isAccepted = norm(computeResidual(newValues)) < (1.0 - 1e-4 * lambda) * _norm;
+        if (isAccepted == false) {
+            lambda /= 2;
+        }
+    }
+    if (isAccepted == false) {
+        lambda = 0.0;
+        for (unsigned int i = 0; i < values.size(); i++) {
+            newValues[i] = values[i] + residual[i];
+        }
+    }
+    _grid->setNormalValues(newValues);
+    if (_masses.empty() == false) {
+        _grid->scaleMasses(_masses);
+    }
+
+    _grid->setCollisionsFrozen(false);
+    _grid->check();
+
+    double relativeNorm = _initialNorm > 0.0 ? _norm / _initialNorm : 0.0;
+    if (Parallel::isMaster()) {
+        std::cout << '\r' << "Newton residual = " << _norm << " (relative " << relativeNorm << ")"
+                  << "; krylov iterations = " << iterations
+                  << "; step = " << lambda << std::endl;
+    }
+    return config->getJfnkTolerance() > 0.0 && relativeNorm < config->getJfnkTolerance();
+}
+
+std::vector<double> NewtonSolver::computeResidual(const std::vector<double>& values) {
+    _grid->setNormalValues(values);
+    _advance();
+    auto residual = _grid->getNormalValues();
+    for (unsigned int i = 0; i < residual.size(); i++) {
+        residual[i] -= values[i];
+    }
+    return residual;
+}
+
+std::vector<double> NewtonSolver::precondition(const std::vector<double>& vector) {
+    double scale = Config::getInstance()->getJfnkPreconditionerScale();
+    if (scale <= 0.0) {
+        return vector;
+    }
+
+    // residual jacobian is about -timestep * transfer, sweep gives (1 + scale * timestep * transfer)^-1,
+    // sweep goes with half timestep like each of two transfers of step
+    _grid->setNormalValues(vector);
+    _grid->computeImplicitSweep(2 * scale);
+    auto result = _grid->getNormalValues();
+    for (auto& value : result) {
+        value *= -scale;
+    }
+    return result;
+}
+
+std::vector<double> NewtonSolver::multiply(const std::vector<double>& values, const std::vector<double>& residual, const std::vector<double>& vector) {
+    double vectorNorm = norm(vector);
+    if (vectorNorm == 0.0) {
+        return std::vector<double>(vector.size(), 0.0);
+    }
+
+    // distribution can't go below zero, collisions aren't defined there
+    double epsilon = std::sqrt(std::numeric_limits<double>::epsilon()) * (1.0 + norm(values)) / vectorNorm;
+    std::vector<double> shifted(values.size());
+    for (unsigned int i = 0; i < values.size(); i++) {
+        shifted[i] = std::max(values[i] + epsilon * vector[i], 0.0);
+    }
+
+    auto product = computeResidual(shifted);
+    for (unsigned int i = 0; i < product.size(); i++) {
+        product[i] = (product[i] - residual[i]) / epsilon;
+    }
+    return product;
+}
+
+std::vector<double> NewtonSolver::solve(const std::vector<double>& values, const std::vector<double>& residual, unsigned int& iterations) {
+    auto config = Config::getInstance();
+    unsigned int krylovSize = std::max(config->getJfnkKrylovSize(), 1u);
+
+    iterations = 0;
+    double beta = norm(residual);
+    if (beta == 0.0) {
+        return std::vector<double>(residual.size(), 0.0);
+    }
+
+    // arnoldi basis, hessenberg matrix by columns and givens rotations
+    std::vector<std::vector<double>> basis(1, residual);
+    for (auto& value : basis[0]) {
+        value /= -beta;
+    }
+    std::vector<std::vector<double>> hessenberg;
+    std::vector<double> cosines, sines;
+    std::vector<double> rhs = {beta};
+
+    for (unsigned int j = 0; j < krylovSize; j++) {
+        auto w = multiply(values, residual, precondition(basis[j]));
+
+        std::vector<double> column(j + 2, 0.0);
+        for (unsigned int i = 0; i <= j; i++) {
+            column[i] = dot(w, basis[i]);
+            for (unsigned int k = 0; k < w.size(); k++) {
+                w[k] -= column[i] * basis[i][k];
+            }
+        }
+        column[j + 1] = norm(w);
+
+        for (unsigned int i = 0; i < j; i++) {
+            double temp = cosines[i] * column[i] + sines[i] * column[i + 1];
+            column[i + 1] = -sines[i] * column[i] + cosines[i] * column[i + 1];
+            column[i] = temp;
+        }
+        double radius = std::hypot(column[j], column[j + 1]);
+        cosines.push_back(radius > 0.0 ? column[j] / radius : 1.0);
+        sines.push_back(radius > 0.0 ? column[j + 1] / radius : 0.0);
+        double nextNorm = column[j + 1];
+        column[j] = radius;
+        column[j + 1] = 0.0;
+        rhs.push_back(-sines[j] * rhs[j]);
+        rhs[j] *= cosines[j];
+        hessenberg.push_back(column);
+        iterations = j + 1;
+
+        if (std::abs(rhs[j + 1]) <= config->getJfnkKrylovTolerance() * beta || nextNorm == 0.0 || iterations == krylovSize) {
+            break;
+        }
+        for (auto& value : w) {
+            value /= nextNorm;
+        }
+        basis.push_back(w);
+    }
+
+    // back substitution, then preconditioner goes once for combination of basis
+    std::vector<double> y(iterations, 0.0);
+    for (int i = static_cast<int>(iterations) - 1; i >= 0; i--) {
+        double sum = rhs[i];
+        for (unsigned int k = i + 1; k < iterations; k++) {
+            sum -= hessenberg[k][i] * y[k];
+        }
+        y[i] = hessenberg[i][i] != 0.0 ? sum / hessenberg[i][i] : 0.0;
+    }
+    std::vector<double> combination(residual.size(), 0.0);
+    for (unsigned int i = 0; i < iterations; i++) {
+        for (unsigned int k = 0; k < combination.size(); k++) {
+            combination[k] += y[i] * basis[i][k];
+        }
+    }
+    return precondition(combination);
+}
+
+double NewtonSolver::dot(const std::vector<double>& a, const std::vector<double>& b) {
+    double sum = 0.0;
+    for (unsigned int i = 0; i < a.size(); i++) {
+        sum += a[i] * b[i];
+    }
+    if (Parallel::isSingle() == false) {
+        sum = Parallel::allReduce({sum}, Parallel::Reduce::SUM)[0];
+    }
+    return sum;
+}
+
+double NewtonSolver::norm(const std::vector<double>& a) {
+    return std::sqrt(dot(a, a));
+}
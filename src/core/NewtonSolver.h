@@ -0,0 +1,50 @@
+#ifndef RGS_NEWTONSOLVER_H
+#define RGS_NEWTONSOLVER_H
+
+#include <functional>
+#include <vector>
+
+class Grid;
+
+// Steady state solver, finds values which one solver step keeps the same by inexact Newton's method.
+// Jacobian is never formed: GMRES takes its products with vectors from differences of steps,
+// right preconditioned by implicit sweep. Collision nodes are frozen within Newton iteration.
+class NewtonSolver {
+private:
+    Grid* _grid;
+    std::function<void()> _advance;     // one solver step without check
+    double _initialNorm;
+    double _norm;                       // of last residual before update
+    std::vector<double> _masses;        // of each gas, kept on closed grid where any multiple of solution is solution too
+
+public:
+    NewtonSolver(Grid* grid, const std::function<void()>& advance);
+
+    // collective, returns true when residual relative to first one is below tolerance
+    bool step();
+
+    double getNorm() const {
+        return _norm;
+    }
+
+private:
+    // step(values) - values, grid is left with step(values)
+    std::vector<double> computeResidual(const std::vector<double>& values);
+
+    // approximate inverse of residual jacobian by sweep with scaled timestep
+    std::vector<double> precondition(const std::vector<double>& vector);
+
+    // jacobian of residual at values multiplied by vector
+    std::vector<double> multiply(const std::vector<double>& values, const std::vector<double>& residual, const std::vector<double>& vector);
+
+    // GMRES without restarts for jacobian * delta = -residual
+    std::vector<double> solve(const std::vector<double>& values, const std::vector<double>& residual, unsigned int& iterations);
+
+    // collective
+    static double dot(const std::vector<double>& a, const std::vector<double>& b);
+
+    static double norm(const std::vector<double>& a);
+
+};
+
+#endif //RGS_NEWTONSOLVER_H
@@ -0,0 +1,175 @@
+#include "ResidualMonitor.h"
+#include "Config.h"
+#include "grid/Grid.h"
+#include "grid/NormalCell.h"
+#include "utilities/Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+ResidualMonitor::ResidualMonitor(Grid* grid, const std::string& filename) : _grid(grid), _hasPrevMoments(false), _prevIteration(0) {
+    auto config = Config::getInstance();
+    auto gasesSize = config->getGases().size();
+    _l2Residuals.resize(gasesSize * QUANTITIES_SIZE, 0.0);
+    _maxResiduals.resize(gasesSize * QUANTITIES_SIZE, 0.0);
+
+    if (config->getResidualNorm() != "l2" && config->getResidualNorm() != "max") {
+        throw std::runtime_error("unknown residual norm: " + config->getResidualNorm());
+    }
+
+    if (Parallel::isMaster()) {
+        _fs.open(filename, std::ios::out | std::ios::trunc);
+        if (_fs.is_open() == false) {
+            throw std::runtime_error("can't open residuals file: " + filename);
+        }
+        _fs << "iteration";
+        for (unsigned int gi = 0; gi < gasesSize; gi++) {
+            for (unsigned int qi = 0; qi < QUANTITIES_SIZE; qi++) {
+                auto name = getQuantityName(static_cast<Quantity>(qi));
+                _fs << "," << name << "_l2_" << gi << "," << name << "_max_" << gi;
+            }
+        }
+        _fs << std::endl;
+    }
+}
+
+bool ResidualMonitor::update(unsigned int iteration) {
+    auto config = Config::getInstance();
+    const auto& gases = config->getGases();
+    const auto& normalCells = _grid->getNormalCells();
+    auto gasesSize = gases.size();
+
+    // sums of squares and cells count are summed over ranks,
+    // maximum changes, density and temperature of each gas are maximized
+    const unsigned int MAXS_SIZE = QUANTITIES_SIZE + 2;
+    std::vector<double> sums(gasesSize * QUANTITIES_SIZE + 1, 0.0);
+    std::vector<double> maxs(gasesSize * MAXS_SIZE, 0.0);
+
+    _prevMoments.resize(normalCells.size() * gasesSize * 5, 0.0);
+    for (unsigned int ci = 0; ci < normalCells.size(); ci++) {
+        for (unsigned int gi = 0; gi < gasesSize; gi++) {
+            double density = 0.0, temperature = 0.0;
+            Vector3d velocity;
+            normalCells[ci]->computeMoments(gi, density, velocity, temperature);
+
+            double* prev = &_prevMoments[(ci * gasesSize + gi) * 5];
+            Vector3d prevVelocity(prev[1], prev[2], prev[3]);
+            double changes[QUANTITIES_SIZE] = {
+                    std::abs(density - prev[0]),
+                    (velocity - prevVelocity).module(),
+                    std::abs(temperature - prev[4])
+            };
+            double* gasMaxs = &maxs[gi * MAXS_SIZE];
+            for (unsigned int qi = 0; qi < QUANTITIES_SIZE; qi++) {
+                sums[gi * QUANTITIES_SIZE + qi] += changes[qi] * changes[qi];
+                gasMaxs[qi] = std::max(gasMaxs[qi], changes[qi]);
+            }
+            gasMaxs[QUANTITIES_SIZE] = std::max(gasMaxs[QUANTITIES_SIZE], density);
+            gasMaxs[QUANTITIES_SIZE + 1] = std::max(gasMaxs[QUANTITIES_SIZE + 1], temperature);
+
+            prev[0] = density;
+            prev[1] = velocity.x();
+            prev[2] = velocity.y();
+            prev[3] = velocity.z();
+            prev[4] = temperature;
+        }
+    }
+    sums[gasesSize * QUANTITIES_SIZE] = normalCells.size();
+
+    if (Parallel::isSingle() == false) {
+        sums = Parallel::allReduce(sums, Parallel::Reduce::SUM);
+        maxs = Parallel::allReduce(maxs, Parallel::Reduce::MAX);
+    }
+
+    // there is nothing to compare with on first check
+    unsigned int iterations = iteration - _prevIteration;
+    bool hasPrevMoments = _hasPrevMoments;
+    _hasPrevMoments = true;
+    _prevIteration = iteration;
+    double cellsSize = sums[gasesSize * QUANTITIES_SIZE];
+    if (hasPrevMoments == false || iterations == 0 || cellsSize == 0.0) {
+        return false;
+    }
+
+    for (unsigned int gi = 0; gi < gasesSize; gi++) {
+        const double* gasMaxs = &maxs[gi * MAXS_SIZE];
+        double maxDensity = gasMaxs[QUANTITIES_SIZE];
+        double maxTemperature = gasMaxs[QUANTITIES_SIZE + 1];
+        double scales[QUANTITIES_SIZE] = {
+                maxDensity,
+                std::sqrt(maxTemperature / gases[gi].getMass()),
+                maxTemperature
+        };
+        for (unsigned int qi = 0; qi < QUANTITIES_SIZE; qi++) {
+            double scale = scales[qi] * iterations;
+            auto index = gi * QUANTITIES_SIZE + qi;
+            _l2Residuals[index] = scale > 0.0 ? std::sqrt(sums[index] / cellsSize) / scale : 0.0;
+            _maxResiduals[index] = scale > 0.0 ? gasMaxs[qi] / scale : 0.0;
+        }
+    }
+
+    write(iteration);
+    return isConverged();
+}
+
+double ResidualMonitor::getL2Residual(unsigned int gi, Quantity quantity) const {
+    return _l2Residuals[gi * QUANTITIES_SIZE + static_cast<unsigned int>(quantity)];
+}
+
+double ResidualMonitor::getMaxResidual(unsigned int gi, Quantity quantity) const {
+    return _maxResiduals[gi * QUANTITIES_SIZE + static_cast<unsigned int>(quantity)];
+}
+
+const char* ResidualMonitor::getQuantityName(Quantity quantity) {
+    switch (quantity) {
+        case Quantity::DENSITY:
+            return "density";
+        case Quantity::VELOCITY:
+            return "velocity";
+        case Quantity::TEMPERATURE:
+            return "temperature";
+    }
+    return "unknown";
+}
+
+bool ResidualMonitor::isConverged() const {
+    auto config = Config::getInstance();
+    double tolerances[QUANTITIES_SIZE] = {
+            config->getResidualDensityTolerance(),
+            config->getResidualVelocityTolerance(),
+            config->getResidualTemperatureTolerance()
+    };
+    bool isMax = config->getResidualNorm() == "max";
+
+    // zero tolerance is not checked, at least one must be set to stop
+    bool isChecked = false;
+    for (unsigned int gi = 0; gi < config->getGases().size(); gi++) {
+        for (unsigned int qi = 0; qi < QUANTITIES_SIZE; qi++) {
+            if (tolerances[qi] <= 0.0) {
+                continue;
+            }
+            isChecked = true;
+
+            auto quantity = static_cast<Quantity>(qi);
+            double residual = isMax ? getMaxResidual(gi, quantity) : getL2Residual(gi, quantity);
+            if (residual > tolerances[qi]) {
+                return false;
+            }
+        }
+    }
+    return isChecked;
+}
+
+void ResidualMonitor::write(unsigned int iteration) {
+    if (Parallel::isMaster() == false) {
+        return;
+    }
+
+    _fs << iteration << std::scientific << std::setprecision(6);
+    for (unsigned int index = 0; index < _l2Residuals.size(); index++) {
+        _fs << "," << _l2Residuals[index] << "," << _maxResiduals[index];
+    }
+    _fs << std::endl;
+}
@@ -0,0 +1,51 @@
+#ifndef RGS_RESIDUALMONITOR_H
+#define RGS_RESIDUALMONITOR_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Grid;
+
+// Tracks change of density, velocity and temperature of normal cells between checks.
+// Residuals are per iteration and relative: density and temperature to their maximum
+// over grid, velocity to thermal speed at maximum temperature.
+class ResidualMonitor {
+public:
+    enum class Quantity {
+        DENSITY,
+        VELOCITY,
+        TEMPERATURE
+    };
+
+    static const unsigned int QUANTITIES_SIZE = static_cast<unsigned int>(Quantity::TEMPERATURE) + 1;
+
+private:
+    Grid* _grid;
+    bool _hasPrevMoments;
+    unsigned int _prevIteration;
+    std::vector<double> _prevMoments;   // density, velocity and temperature for each cell and gas
+    std::vector<double> _l2Residuals;   // for each gas and quantity
+    std::vector<double> _maxResiduals;
+    std::ofstream _fs;                  // csv history, on master only
+
+public:
+    ResidualMonitor(Grid* grid, const std::string& filename);
+
+    // collective, first call only saves moments, returns true when residuals of all gases are below configured tolerances
+    bool update(unsigned int iteration);
+
+    double getL2Residual(unsigned int gi, Quantity quantity) const;
+
+    double getMaxResidual(unsigned int gi, Quantity quantity) const;
+
+    static const char* getQuantityName(Quantity quantity);
+
+private:
+    bool isConverged() const;
+
+    void write(unsigned int iteration);
+
+};
+
+#endif //RGS_RESIDUALMONITOR_H
@@ -4,32 +4,61 @@
 #include "grid/Grid.h"
 #include "grid/NormalCell.h"
 #include "mesh/Mesh.h"
+#include "utilities/Parallel.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+#include <stdexcept>
 
 using namespace boost::filesystem;
 
 ResultsFormatter::ResultsFormatter() {
     auto config = Config::getInstance();
     _root = config->getOutputFolder();
-    _main = Utils::getCurrentDateAndTime() + "_" + config->getName();
     _scalarParams = {Param::PRESSURE, Param::DENSITY, Param::TEMPERATURE};
     _vectorParams = {Param::FLOW, Param::HEATFLOW};
+
+    if (config->getOutputFormat() == "vtk") {
+        _format = Format::VTK;
+    } else if (config->getOutputFormat() == "pvtu") {
+        _format = Format::PVTU;
+    } else {
+        throw std::runtime_error("unknown output format: " + config->getOutputFormat());
+    }
+
+    if (config->getOutputEncoding() == "ascii") {
+        _encoding = Encoding::ASCII;
+    } else if (config->getOutputEncoding() == "binary") {
+        _encoding = Encoding::BINARY;
+    } else if (config->getOutputEncoding() == "zlib") {
+        _encoding = Encoding::ZLIB;
+    } else {
+        throw std::runtime_error("unknown output encoding: " + config->getOutputEncoding());
+    }
+
+    // all ranks must write into the same folder, so master decides its name
+    if (Parallel::isMaster()) {
+        _main = Utils::getCurrentDateAndTime() + "_" + config->getName();
+        for (int processor = 1; processor < Parallel::getSize(); processor++) {
+            Parallel::send(_main, processor, Parallel::COMMAND_OUTPUT_FOLDER);
+        }
+    } else {
+        _main = Parallel::recv(0, Parallel::COMMAND_OUTPUT_FOLDER);
+    }
 }
 
 void ResultsFormatter::writeAll(unsigned int iteration, Mesh* mesh, const std::vector<CellResults*>& results) {
-    if (exists(_root) == false) {
-        std::cout << "No such folder: " << _root << std::endl;
+    if (createMainFolder() == false) {
         return;
     }
 
-    path mainPath{_root / _main};
-    if (exists(mainPath) == false) {
-        create_directory(mainPath);
-    }
-
-    path filePath = mainPath / (Utils::toString(iteration) + ".vtk"); // _types[Type::DATA] /
+    path filePath = path(_root) / _main / (Utils::toString(iteration) + ".vtk"); // _types[Type::DATA] /
     std::ofstream fs(filePath.generic_string(), std::ios::out); //  | std::ios::binary
 
     // writing file
@@ -47,18 +76,25 @@ void ResultsFormatter::writeAll(unsigned int iteration, Mesh* mesh, const std::v
         double x = point.x() / units;
         double y = point.y() / units;
         double z = point.z() / units;
-        fs << x << " " << y << " " << z << std::endl;
+        fs << x << " " << y << " " << z << '\n';
     }
     fs << std::endl;
 
+    // index results by cell id
+    std::unordered_map<int, const CellResults*> resultsIndex;
+    resultsIndex.reserve(results.size());
+    for (auto cellResults : results) {
+        resultsIndex[cellResults->getId()] = cellResults;
+    }
+
     // cells
     std::vector<Element*> elements;
+    std::vector<const CellResults*> elementsResults;
     for (const auto& element : mesh->getElements()) {
-        auto pos = std::find_if(results.begin(), results.end(), [&element](CellResults* res) {
-            return element->getId() == res->getId();
-        });
-        if (pos != results.end()) {
+        auto pos = resultsIndex.find(element->getId());
+        if (pos != resultsIndex.end()) {
             elements.push_back(element.get());
+            elementsResults.push_back(pos->second);
         }
     }
     auto numberOfAllIndices = 0;
@@ -73,38 +109,14 @@ void ResultsFormatter::writeAll(unsigned int iteration, Mesh* mesh, const std::v
         for (const auto& nodeId : nodeIds) {
             fs << " " << (nodeId - 1);
         }
-        fs << std::endl;
+        fs << '\n';
     }
     fs << std::endl;
 
     // cell types
     fs << "CELL_TYPES " << elements.size() << std::endl;
     for (auto element : elements) {
-        int cellType = 0;
-        switch (element->getType()) {
-            case Element::Type::POINT:
-                cellType = 1;
-                break;
-            case Element::Type::LINE:
-                cellType = 3;
-                break;
-            case Element::Type::TRIANGLE:
-                cellType = 5;
-                break;
-            case Element::Type::QUADRANGLE:
-                cellType = 9;
-                break;
-            case Element::Type::TETRAHEDRON:
-                cellType = 10;
-                break;
-            case Element::Type::HEXAHEDRON:
-                cellType = 12;
-                break;
-            case Element::Type::PRISM:
-                cellType = 13;
-                break;
-        }
-        fs << cellType << std::endl;
+        fs << getCellType(element) << '\n';
     }
     fs << std::endl;
 
@@ -112,86 +124,357 @@ void ResultsFormatter::writeAll(unsigned int iteration, Mesh* mesh, const std::v
     fs << "CELL_DATA " << elements.size() << std::endl;
 
     auto config = Config::getInstance();
-    auto normalizer = config->getNormalizer();
 
     for (auto gi = 0; gi < config->getGases().size(); gi++) {
         for (auto param : _scalarParams) {
-            std::string paramName;
-            switch (param) {
-                case Param::PRESSURE:
-                    paramName = "Pressure";
-                    break;
-                case Param::DENSITY:
-                    paramName = "Density";
-                    break;
-                case Param::TEMPERATURE:
-                    paramName = "Temperature";
-                    break;
-            }
-            paramName += "_" + Utils::toString(gi);
+            std::string paramName = getParamName(param, gi);
 
             fs << "SCALARS " << paramName << " " << "double" << " " << 1 << std::endl;
             fs << "LOOKUP_TABLE " << "default" << std::endl;
-            for (auto element : elements) {
-                double value = 0.0;
-                auto pos = std::find_if(results.begin(), results.end(), [&element](CellResults* res) {
-                    return element->getId() == res->getId();
-                });
-                if (pos != results.end()) {
-                    switch (param) {
-                        case Param::PRESSURE:
-                            value = normalizer->restore((*pos)->getPressure(gi), Normalizer::Type::PRESSURE);
-                            break;
-                        case Param::DENSITY:
-                            value = normalizer->restore((*pos)->getDensity(gi), Normalizer::Type::DENSITY);
-                            break;
-                        case Param::TEMPERATURE:
-                            value = normalizer->restore((*pos)->getTemp(gi), Normalizer::Type::TEMPERATURE);
-                            break;
-                    }
-                }
-                fs << value << std::endl;
+            for (auto cellResults : elementsResults) {
+                fs << getScalarValue(param, gi, cellResults) << '\n';
             }
         }
 
         for (auto param : _vectorParams) {
-            std::string paramName;
-            switch (param) {
-                case Param::FLOW:
-                    paramName = "Flow";
-                    break;
-                case Param::HEATFLOW:
-                    paramName = "HeatFlow";
-                    break;
-            }
-            paramName += "_" + Utils::toString(gi);
+            std::string paramName = getParamName(param, gi);
 
             fs << "VECTORS " << paramName << " " << "double" << std::endl;
-            for (auto element : elements) {
-                Vector3d value;
-                auto pos = std::find_if(results.begin(), results.end(), [&element](CellResults* res) {
-                    return element->getId() == res->getId();
-                });
-                if (pos != results.end()) {
-                    switch (param) {
-                        case Param::FLOW:
-                            value = (*pos)->getFlow(gi);
-                            normalizer->restore(value.x(), Normalizer::Type::FLOW);
-                            normalizer->restore(value.y(), Normalizer::Type::FLOW);
-                            normalizer->restore(value.z(), Normalizer::Type::FLOW);
-                            break;
-                        case Param::HEATFLOW:
-                            value = (*pos)->getHeatFlow(gi);
-                            normalizer->restore(value.x(), Normalizer::Type::HEATFLOW);
-                            normalizer->restore(value.y(), Normalizer::Type::HEATFLOW);
-                            normalizer->restore(value.z(), Normalizer::Type::HEATFLOW);
-                            break;
-                    }
-                }
-                fs << value.x() << " " << value.y() << " " << value.z() << std::endl;
+            for (auto cellResults : elementsResults) {
+                Vector3d value = getVectorValue(param, gi, cellResults);
+                fs << value.x() << " " << value.y() << " " << value.z() << '\n';
+            }
+        }
+    }
+
+    fs.close();
+}
+
+void ResultsFormatter::writePiece(unsigned int iteration, Mesh* mesh, const std::vector<CellResults*>& results) {
+    if (createMainFolder() == false) {
+        return;
+    }
+
+    // cells of current rank and only nodes they use, renumbered locally
+    std::vector<Element*> elements;
+    std::vector<Node*> nodes;
+    std::unordered_map<int, int64_t> nodeIndices;
+    for (auto cellResults : results) {
+        auto element = mesh->getElement(cellResults->getId());
+        elements.push_back(element);
+        for (auto nodeId : element->getNodeIds()) {
+            if (nodeIndices.count(nodeId) == 0) {
+                nodeIndices[nodeId] = static_cast<int64_t>(nodes.size());
+                nodes.push_back(mesh->getNode(nodeId));
+            }
+        }
+    }
+
+    // points
+    DataArray points{"Float64", "Points", 3, ""};
+    points.data.reserve(nodes.size() * 3 * sizeof(double));
+    double units = Config::getInstance()->getMeshUnits();
+    for (auto node : nodes) {
+        const auto& point = node->getPosition();
+        append(points, point.x() / units);
+        append(points, point.y() / units);
+        append(points, point.z() / units);
+    }
+
+    // cells
+    DataArray connectivity{"Int64", "connectivity", 1, ""};
+    DataArray offsets{"Int64", "offsets", 1, ""};
+    DataArray types{"UInt8", "types", 1, ""};
+    int64_t offset = 0;
+    for (auto element : elements) {
+        for (auto nodeId : element->getNodeIds()) {
+            append(connectivity, nodeIndices[nodeId]);
+        }
+        offset += element->getNodeIds().size();
+        append(offsets, offset);
+        append(types, static_cast<uint8_t>(getCellType(element)));
+    }
+
+    // cell data, results go in the same order as elements
+    std::vector<DataArray> cellData;
+    for (unsigned int gi = 0; gi < Config::getInstance()->getGases().size(); gi++) {
+        for (auto param : _scalarParams) {
+            DataArray array{"Float64", getParamName(param, gi), 1, ""};
+            array.data.reserve(results.size() * sizeof(double));
+            for (auto cellResults : results) {
+                append(array, getScalarValue(param, gi, cellResults));
+            }
+            cellData.push_back(std::move(array));
+        }
+        for (auto param : _vectorParams) {
+            DataArray array{"Float64", getParamName(param, gi), 3, ""};
+            array.data.reserve(results.size() * 3 * sizeof(double));
+            for (auto cellResults : results) {
+                Vector3d value = getVectorValue(param, gi, cellResults);
+                append(array, value.x());
+                append(array, value.y());
+                append(array, value.z());
             }
+            cellData.push_back(std::move(array));
         }
     }
 
+    path filePath = path(_root) / _main / getPieceFilename(iteration, Parallel::getRank());
+    std::ofstream fs(filePath.generic_string(), std::ios::out | std::ios::binary);
+
+    fs << "<?xml version=\"1.0\"?>" << std::endl;
+    fs << "<VTKFile type=\"UnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\" header_type=\"UInt64\"";
+    if (_encoding == Encoding::ZLIB) {
+        fs << " compressor=\"vtkZLibDataCompressor\"";
+    }
+    fs << ">" << std::endl;
+    fs << "<UnstructuredGrid>" << std::endl;
+    fs << "<Piece NumberOfPoints=\"" << nodes.size() << "\" NumberOfCells=\"" << elements.size() << "\">" << std::endl;
+
+    std::size_t appendedOffset = 0;
+    std::vector<std::string> appended;
+    fs << "<Points>" << std::endl;
+    writeDataArray(fs, points, appendedOffset, appended);
+    fs << "</Points>" << std::endl;
+    fs << "<Cells>" << std::endl;
+    writeDataArray(fs, connectivity, appendedOffset, appended);
+    writeDataArray(fs, offsets, appendedOffset, appended);
+    writeDataArray(fs, types, appendedOffset, appended);
+    fs << "</Cells>" << std::endl;
+    fs << "<CellData>" << std::endl;
+    for (const auto& array : cellData) {
+        writeDataArray(fs, array, appendedOffset, appended);
+    }
+    fs << "</CellData>" << std::endl;
+
+    fs << "</Piece>" << std::endl;
+    fs << "</UnstructuredGrid>" << std::endl;
+
+    // binary data goes after xml part in the same order as arrays were declared
+    if (_encoding != Encoding::ASCII) {
+        fs << "<AppendedData encoding=\"raw\">" << std::endl;
+        fs << "_";
+        for (const auto& encoded : appended) {
+            fs << encoded;
+        }
+        fs << std::endl;
+        fs << "</AppendedData>" << std::endl;
+    }
+
+    fs << "</VTKFile>" << std::endl;
+
     fs.close();
 }
+
+void ResultsFormatter::writeIndex(unsigned int iteration) {
+    if (createMainFolder() == false) {
+        return;
+    }
+
+    path filePath = path(_root) / _main / (Utils::toString(iteration) + ".pvtu");
+    std::ofstream fs(filePath.generic_string(), std::ios::out);
+
+    fs << "<?xml version=\"1.0\"?>" << std::endl;
+    fs << "<VTKFile type=\"PUnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\">" << std::endl;
+    fs << "<PUnstructuredGrid GhostLevel=\"0\">" << std::endl;
+
+    fs << "<PPoints>" << std::endl;
+    fs << "<PDataArray type=\"Float64\" NumberOfComponents=\"3\"/>" << std::endl;
+    fs << "</PPoints>" << std::endl;
+
+    fs << "<PCellData>" << std::endl;
+    for (unsigned int gi = 0; gi < Config::getInstance()->getGases().size(); gi++) {
+        for (auto param : _scalarParams) {
+            fs << "<PDataArray type=\"Float64\" Name=\"" << getParamName(param, gi) << "\"/>" << std::endl;
+        }
+        for (auto param : _vectorParams) {
+            fs << "<PDataArray type=\"Float64\" Name=\"" << getParamName(param, gi) << "\" NumberOfComponents=\"3\"/>" << std::endl;
+        }
+    }
+    fs << "</PCellData>" << std::endl;
+
+    for (int rank = 0; rank < Parallel::getSize(); rank++) {
+        fs << "<Piece Source=\"" << getPieceFilename(iteration, rank) << "\"/>" << std::endl;
+    }
+
+    fs << "</PUnstructuredGrid>" << std::endl;
+    fs << "</VTKFile>" << std::endl;
+
+    fs.close();
+}
+
+bool ResultsFormatter::createMainFolder() {
+    if (exists(_root) == false) {
+        std::cout << "No such folder: " << _root << std::endl;
+        return false;
+    }
+
+    // several ranks can create it at the same time
+    path mainPath{_root / _main};
+    if (exists(mainPath) == false) {
+        boost::system::error_code error;
+        create_directory(mainPath, error);
+    }
+    return true;
+}
+
+std::string ResultsFormatter::getPieceFilename(unsigned int iteration, int rank) const {
+    return Utils::toString(iteration) + "_" + Utils::toString(rank) + ".vtu";
+}
+
+void ResultsFormatter::writeDataArray(std::ostream& os, const DataArray& array, std::size_t& offset, std::vector<std::string>& appended) const {
+    os << "<DataArray type=\"" << array.type << "\" Name=\"" << array.name << "\"";
+    if (array.components > 1) {
+        os << " NumberOfComponents=\"" << array.components << "\"";
+    }
+    if (_encoding == Encoding::ASCII) {
+        os << " format=\"ascii\">" << std::endl;
+        writeAsciiValues(os, array);
+        os << "</DataArray>" << std::endl;
+    } else {
+        os << " format=\"appended\" offset=\"" << offset << "\"/>" << std::endl;
+        appended.push_back(encode(array));
+        offset += appended.back().size();
+    }
+}
+
+void ResultsFormatter::writeAsciiValues(std::ostream& os, const DataArray& array) const {
+    const char* data = array.data.data();
+    if (array.type == "Float64") {
+        std::size_t size = array.data.size() / sizeof(double);
+        for (std::size_t i = 0; i < size; i++) {
+            double value;
+            std::memcpy(&value, data + i * sizeof(double), sizeof(double));
+            os << value << ((i + 1) % array.components == 0 ? '\n' : ' ');
+        }
+    } else if (array.type == "Int64") {
+        std::size_t size = array.data.size() / sizeof(int64_t);
+        for (std::size_t i = 0; i < size; i++) {
+            int64_t value;
+            std::memcpy(&value, data + i * sizeof(int64_t), sizeof(int64_t));
+            os << value << ((i + 1) % array.components == 0 ? '\n' : ' ');
+        }
+    } else if (array.type == "UInt8") {
+        for (std::size_t i = 0; i < array.data.size(); i++) {
+            os << static_cast<int>(static_cast<uint8_t>(data[i])) << '\n';
+        }
+    }
+}
+
+std::string ResultsFormatter::encode(const DataArray& array) const {
+    std::string encoded;
+    if (_encoding == Encoding::BINARY) {
+
+        // header is the size of data in bytes
+        auto size = static_cast<uint64_t>(array.data.size());
+        encoded.append(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+        encoded.append(array.data);
+    } else if (_encoding == Encoding::ZLIB) {
+
+        // data is split into blocks compressed independently
+        const std::size_t blockSize = 1 << 15;
+        std::size_t blocksCount = (array.data.size() + blockSize - 1) / blockSize;
+        std::size_t lastBlockSize = array.data.size() - (blocksCount > 0 ? (blocksCount - 1) * blockSize : 0);
+
+        std::vector<std::string> blocks;
+        for (std::size_t bi = 0; bi < blocksCount; bi++) {
+            std::string block;
+            {
+                boost::iostreams::filtering_ostream os;
+                os.push(boost::iostreams::zlib_compressor());
+                os.push(boost::iostreams::back_inserter(block));
+                os.write(array.data.data() + bi * blockSize, bi + 1 == blocksCount ? lastBlockSize : blockSize);
+            }
+            blocks.push_back(std::move(block));
+        }
+
+        // header: number of blocks, block size, last block size, compressed size of each block
+        std::vector<uint64_t> header = {blocksCount, blockSize, blocksCount > 0 ? lastBlockSize : 0};
+        for (const auto& block : blocks) {
+            header.push_back(block.size());
+        }
+        encoded.append(reinterpret_cast<const char*>(header.data()), header.size() * sizeof(uint64_t));
+        for (const auto& block : blocks) {
+            encoded.append(block);
+        }
+    }
+    return encoded;
+}
+
+int ResultsFormatter::getCellType(const Element* element) {
+    switch (element->getType()) {
+        case Element::Type::POINT:
+            return 1;
+        case Element::Type::LINE:
+            return 3;
+        case Element::Type::TRIANGLE:
+            return 5;
+        case Element::Type::QUADRANGLE:
+            return 9;
+        case Element::Type::TETRAHEDRON:
+            return 10;
+        case Element::Type::HEXAHEDRON:
+            return 12;
+        case Element::Type::PRISM:
+            return 13;
+    }
+    return 0;
+}
+
+std::string ResultsFormatter::getParamName(Param param, unsigned int gi) {
+    std::string paramName;
+    switch (param) {
+        case Param::PRESSURE:
+            paramName = "Pressure";
+            break;
+        case Param::DENSITY:
+            paramName = "Density";
+            break;
+        case Param::TEMPERATURE:
+            paramName = "Temperature";
+            break;
+        case Param::FLOW:
+            paramName = "Flow";
+            break;
+        case Param::HEATFLOW:
+            paramName = "HeatFlow";
+            break;
+    }
+    return paramName + "_" + Utils::toString(gi);
+}
+
+double ResultsFormatter::getScalarValue(Param param, unsigned int gi, const CellResults* results) {
+    auto normalizer = Config::getInstance()->getNormalizer();
+    switch (param) {
+        case Param::PRESSURE:
+            return normalizer->restore(results->getPressure(gi), Normalizer::Type::PRESSURE);
+        case Param::DENSITY:
+            return normalizer->restore(results->getDensity(gi), Normalizer::Type::DENSITY);
+        case Param::TEMPERATURE:
+            return normalizer->restore(results->getTemp(gi), Normalizer::Type::TEMPERATURE);
+        default:
+            return 0.0;
+    }
+}
+
+Vector3d ResultsFormatter::getVectorValue(Param param, unsigned int gi, const CellResults* results) {
+    auto normalizer = Config::getInstance()->getNormalizer();
+    Vector3d value;
+    switch (param) {
+        case Param::FLOW:
+            value = results->getFlow(gi);
+            normalizer->restore(value.x(), Normalizer::Type::FLOW);
+            normalizer->restore(value.y(), Normalizer::Type::FLOW);
+            normalizer->restore(value.z(), Normalizer::Type::FLOW);
+            break;
+        case Param::HEATFLOW:
+            value = results->getHeatFlow(gi);
+            normalizer->restore(value.x(), Normalizer::Type::HEATFLOW);
+            normalizer->restore(value.y(), Normalizer::Type::HEATFLOW);
+            normalizer->restore(value.z(), Normalizer::Type::HEATFLOW);
+            break;
+        default:
+            break;
+    }
+    return value;
+}
@@ -1,10 +1,13 @@
 #ifndef RGS_RESULTSPRINTER_H
 #define RGS_RESULTSPRINTER_H
 
+#include "utilities/Types.h"
+
 #include <string>
 #include <vector>
 
 class Mesh;
+class Element;
 class CellResults;
 
 class ResultsFormatter {
@@ -17,8 +20,29 @@ private:
         HEATFLOW
     };
 
+    enum class Format {
+        VTK,    // one legacy file written by master
+        PVTU    // piece per rank plus index written by master
+    };
+
+    enum class Encoding {
+        ASCII,
+        BINARY, // raw appended data
+        ZLIB    // zlib compressed appended data
+    };
+
+    // raw little endian values of one vtu data array
+    struct DataArray {
+        std::string type;
+        std::string name;
+        unsigned int components;
+        std::string data;
+    };
+
     std::string _root;
     std::string _main;
+    Format _format;
+    Encoding _encoding;
 
     std::vector<Param> _scalarParams;
     std::vector<Param> _vectorParams;
@@ -26,8 +50,44 @@ private:
 public:
     ResultsFormatter();
 
+    bool isDistributed() const {
+        return _format == Format::PVTU;
+    }
+
+    // legacy vtk with all mesh nodes, results of all ranks must be gathered
     void writeAll(unsigned int iteration, Mesh* mesh, const std::vector<CellResults*>& results);
 
+    // vtu piece with results of current rank only
+    void writePiece(unsigned int iteration, Mesh* mesh, const std::vector<CellResults*>& results);
+
+    // pvtu index referencing pieces of all ranks
+    void writeIndex(unsigned int iteration);
+
+private:
+    bool createMainFolder();
+
+    std::string getPieceFilename(unsigned int iteration, int rank) const;
+
+    // binary arrays are encoded once and kept in appended, offset goes after them
+    void writeDataArray(std::ostream& os, const DataArray& array, std::size_t& offset, std::vector<std::string>& appended) const;
+
+    void writeAsciiValues(std::ostream& os, const DataArray& array) const;
+
+    std::string encode(const DataArray& array) const;
+
+    template<typename T>
+    static void append(DataArray& array, T value) {
+        array.data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static int getCellType(const Element* element);
+
+    static std::string getParamName(Param param, unsigned int gi);
+
+    static double getScalarValue(Param param, unsigned int gi, const CellResults* results);
+
+    static Vector3d getVectorValue(Param param, unsigned int gi, const CellResults* results);
+
 };
 
 
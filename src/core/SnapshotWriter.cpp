@@ -0,0 +1,119 @@
+#include "SnapshotWriter.h"
+#include "ResultsFormatter.h"
+#include "utilities/Parallel.h"
+#include "utilities/Profiler.h"
+
+SnapshotWriter::SnapshotWriter(ResultsFormatter* formatter, Mesh* mesh, unsigned int capacity)
+: _formatter(formatter), _mesh(mesh), _capacity(capacity), _isFinishing(false) {}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isFinishing = true;
+        }
+        _notEmpty.notify_all();
+        _thread.join();
+    }
+}
+
+void SnapshotWriter::push(unsigned int iteration, std::vector<CellResults> results) {
+    if (_capacity == 0) {
+        Snapshot snapshot{iteration, std::move(results)};
+        write(snapshot);
+        return;
+    }
+
+    // thread starts with first snapshot after construction or finish
+    if (_thread.joinable() == false) {
+        _isFinishing = false;
+        _thread = std::thread(&SnapshotWriter::loop, this);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this] {
+            return _queue.size() < _capacity || _error != nullptr;
+        });
+        rethrowError();
+        _queue.push_back({iteration, std::move(results)});
+    }
+    _notEmpty.notify_one();
+}
+
+void SnapshotWriter::finish() {
+    if (_thread.joinable() == false) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isFinishing = true;
+    }
+    _notEmpty.notify_all();
+    _thread.join();
+
+    // no thread is left, next push starts new one
+    rethrowError();
+}
+
+void SnapshotWriter::loop() {
+    Tracer::setThreadName("writer");
+    while (true) {
+        Snapshot snapshot;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _notEmpty.wait(lock, [this] {
+                return _queue.empty() == false || _isFinishing;
+            });
+            if (_queue.empty()) {
+                return;
+            }
+            snapshot = std::move(_queue.front());
+        }
+
+        // slot stays taken until the snapshot is written, it is our second buffer
+        try {
+            write(snapshot);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _error = std::current_exception();
+            _queue.clear();
+            _notFull.notify_all();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.pop_front();
+        }
+        _notFull.notify_one();
+    }
+}
+
+void SnapshotWriter::write(Snapshot& snapshot) {
+    ScopedTimer timer(Profiler::Phase::OUTPUT_WRITE);
+
+    std::vector<CellResults*> results;
+    results.reserve(snapshot.results.size());
+    for (auto& cellResults : snapshot.results) {
+        results.push_back(&cellResults);
+    }
+
+    if (_formatter->isDistributed()) {
+        _formatter->writePiece(snapshot.iteration, _mesh, results);
+        if (Parallel::isMaster() == true) {
+            _formatter->writeIndex(snapshot.iteration);
+        }
+    } else {
+        _formatter->writeAll(snapshot.iteration, _mesh, results);
+    }
+}
+
+void SnapshotWriter::rethrowError() {
+    if (_error != nullptr) {
+        std::exception_ptr error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
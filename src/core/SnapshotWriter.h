@@ -0,0 +1,58 @@
+#ifndef RGS_SNAPSHOTWRITER_H
+#define RGS_SNAPSHOTWRITER_H
+
+#include "grid/CellResults.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+class Mesh;
+class ResultsFormatter;
+
+// Writes results in background thread, so solver can go on with next iterations.
+// Queue is bounded: when disk can't keep up, push waits for free slot.
+class SnapshotWriter {
+private:
+    struct Snapshot {
+        unsigned int iteration;
+        std::vector<CellResults> results;
+    };
+
+    ResultsFormatter* _formatter;
+    Mesh* _mesh;
+    unsigned int _capacity;
+
+    std::deque<Snapshot> _queue;
+    std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    std::thread _thread;
+    bool _isFinishing;
+    std::exception_ptr _error;
+
+public:
+    // capacity = 0 means that results are written synchronously
+    SnapshotWriter(ResultsFormatter* formatter, Mesh* mesh, unsigned int capacity);
+
+    ~SnapshotWriter();
+
+    void push(unsigned int iteration, std::vector<CellResults> results);
+
+    // waits until all queued snapshots are written and stops thread
+    void finish();
+
+private:
+    void loop();
+
+    void write(Snapshot& snapshot);
+
+    void rethrowError();
+
+};
+
+
+#endif //RGS_SNAPSHOTWRITER_H
@@ -5,43 +5,68 @@
 #include "utilities/Parallel.h"
 #include "utilities/Utils.h"
 #include "utilities/SerializationUtils.h"
+#include "utilities/Profiler.h"
 #include "mesh/MeshParser.h"
+#include "mesh/MeshGenerator.h"
 #include "ResultsFormatter.h"
+#include "SnapshotWriter.h"
+#include "Checkpoint.h"
+#include "MemoryReport.h"
+#include "ResidualMonitor.h"
+#include "NewtonSolver.h"
+#include "AndersonMixer.h"
+#include "Multigrid.h"
 #include "KeyboardManager.h"
 
 #include <chrono>
 #include <stdexcept>
+#include <boost/filesystem/path.hpp>
 
 Solver::Solver() {
     _config = Config::getInstance();
-    _formatter = new ResultsFormatter();
+    _formatter.reset(new ResultsFormatter());
     _keyboard = KeyboardManager::getInstance();
+    _residualMonitor = nullptr;
+    _newtonSolver = nullptr;
+    _andersonMixer = nullptr;
+    _multigrid = nullptr;
+    _startIteration = 0;
 }
 
+Solver::~Solver() = default;
+
 void Solver::init() {
     Mesh* mesh = nullptr;
+    double meshTransferBytes = 0.0;
+
+    Profiler::setEnabled(_config->isUsingProfiler());
+    Tracer::setEnabled(_config->isUsingTrace(), _config->getTraceStartIteration(), _config->getTraceEndIteration());
 
     if (Parallel::isSingle() == false) {
         if (Parallel::isMaster() == true) {
 
             // load mesh
-            mesh = MeshParser::getInstance().loadMesh(_config->getMeshFilename(), _config->getMeshUnits());
+            mesh = loadMesh();
             mesh->init();
 
             // send to other processes
+            std::string buffer = SerializationUtils::serialize(mesh);
+            meshTransferBytes = buffer.size();
             for (int processor = 1; processor < Parallel::getSize(); processor++) {
-                Parallel::send(SerializationUtils::serialize(mesh), processor, Parallel::COMMAND_MESH);
+                Parallel::send(buffer, processor, Parallel::COMMAND_MESH);
             }
         } else {
 
             // get mesh from master process
-            SerializationUtils::deserialize(Parallel::recv(0, Parallel::COMMAND_MESH), mesh);
+            std::string buffer = Parallel::recv(0, Parallel::COMMAND_MESH);
+            meshTransferBytes = buffer.size();
+            SerializationUtils::deserialize(buffer, mesh);
             mesh->resetMaps();
         }
     } else {
 
         // load mesh
-        mesh = MeshParser::getInstance().loadMesh(_config->getMeshFilename(), _config->getMeshUnits());
+        mesh = loadMesh();
         mesh->init();
     }
 
@@ -49,11 +74,71 @@ void Solver::init() {
     _grid = new Grid(mesh);
     _grid->init();
 
+    MemoryReport::count(_grid, meshTransferBytes).print();
+
+    _writer.reset(new SnapshotWriter(_formatter.get(), mesh, _config->getOutputQueueSize()));
+
     // initiate integral
     if (_config->isUsingIntegral()) {
         ci::Potential* potential = new ci::HSPotential;
         ci::init(potential, ci::NO_SYMM);
     }
+    if (_config->getModelCollisionKnudsen() < 0.0) {
+        throw std::runtime_error("model collision knudsen must not be negative");
+    }
+    if (_config->getCollisionSkipTolerance() > 0.0 && _config->getCollisionSkipEachIteration() == 0) {
+        throw std::runtime_error("collision skip each iteration must be positive");
+    }
+
+    // continue from saved distribution functions
+    _checkpoint = new Checkpoint(_grid, _config->getCheckpointFolder());
+    if (_config->getRestartFolder().empty() == false) {
+        _startIteration = _checkpoint->restore(_config->getRestartFolder());
+    }
+
+    if (_config->getResidualEachIteration() != 0) {
+        auto filename = boost::filesystem::path(_config->getOutputFolder()) / (_config->getName() + "_residuals.csv");
+        _residualMonitor = new ResidualMonitor(_grid, filename.generic_string());
+    }
+
+    if (_config->getSteadySolver() == "jfnk") {
+        _newtonSolver = new NewtonSolver(_grid, [this] { advance(false); });
+    } else if (_config->getSteadySolver() == "anderson") {
+        if (_config->getAndersonEachIteration() == 0 || _config->getAndersonDepth() == 0) {
+            throw std::runtime_error("anderson depth and each iteration must be positive");
+        }
+        if (_config->getAndersonResidual() != "values" && _config->getAndersonResidual() != "moments") {
+            throw std::runtime_error("unknown anderson residual: " + _config->getAndersonResidual());
+        }
+        _andersonMixer = new AndersonMixer(_grid);
+    } else if (_config->getSteadySolver() == "multigrid") {
+        _multigrid = new Multigrid(_grid, [this] { advance(false); });
+    } else if (_config->getSteadySolver() != "march") {
+        throw std::runtime_error("unknown steady solver: " + _config->getSteadySolver());
+    }
+
+    Tracer::start();
+}
+
+void Solver::estimateMemory() {
+    if (Parallel::isMaster() == false) {
+        return;
+    }
+
+    Mesh* mesh = loadMesh();
+    mesh->init();
+
+    // serialized mesh is sent to each rank when mesh is partitioned
+    double meshTransferBytes = SerializationUtils::serialize(mesh).size();
+    MemoryReport::printEstimate(MemoryReport::estimate(mesh, meshTransferBytes));
+}
+
+Mesh* Solver::loadMesh() {
+    const auto& meshFilename = _config->getMeshFilename();
+    if (MeshGenerator::isGeneratorSpec(meshFilename)) {
+        return MeshGenerator::generate(meshFilename, _config->getMeshUnits());
+    }
+    return MeshParser::getInstance().loadMesh(meshFilename, _config->getMeshUnits());
 }
 
 void Solver::run() {
@@ -67,50 +152,67 @@ void Solver::run() {
     }
 
     // write initial results
-    writeResults(0);
+    Tracer::setIteration(_startIteration);
+    writeResults(_startIteration);
+
+    // residuals are counted from initial moments
+    if (_residualMonitor != nullptr) {
+        _residualMonitor->update(_startIteration);
+    }
 
     unsigned int prevPercent = 0;
     unsigned int maxIterations = _config->getMaxIterations();
-    for (unsigned int iteration = 1; iteration <= maxIterations; iteration++) {
+    unsigned int lastIteration = maxIterations;
+    for (unsigned int iteration = _startIteration + 1; iteration <= maxIterations; iteration++) {
+        Tracer::setIteration(iteration);
+        ScopedTimer iterationTimer(Profiler::Phase::ITERATION);
 
-        // transfer
-        _grid->computeTransfer();
-
-        // integral
-        if (_config->isUsingIntegral()) {
-            int gasesSize = _config->getGases().size();
-            if (gasesSize == 1) {
-                _grid->computeIntegral(0, 0);
-            } else if (gasesSize == 2) {
-                _grid->computeIntegral(0, 0);
-                _grid->computeIntegral(0, 1);
-            } else if (gasesSize >= 3) {
-                _grid->computeIntegral(0, 0);
-                _grid->computeIntegral(0, 1);
-                _grid->computeIntegral(0, 2);
-            }
+        // cells near equilibrium are found again each few iterations, flags stay within iteration
+        auto collisionSkipTolerance = _config->getCollisionSkipTolerance();
+        if (_config->isUsingIntegral() && collisionSkipTolerance > 0.0 &&
+            (iteration - _startIteration - 1) % _config->getCollisionSkipEachIteration() == 0) {
+            _grid->updateCollisionSkipping(collisionSkipTolerance);
         }
 
-        // beta decay
-        if (_config->isUsingBetaDecay()) {
-            const auto& betaChains = _config->getBetaChains();
-            for (const auto& betaChain : betaChains) {
-                _grid->computeBetaDecay(betaChain.getGasIndex1(), betaChain.getGasIndex2(), betaChain.getLambda1());
-                _grid->computeBetaDecay(betaChain.getGasIndex2(), betaChain.getGasIndex3(), betaChain.getLambda2());
-            }
+        // newton iteration stops itself when its residual is small enough
+        bool isConverged = false;
+        if (_newtonSolver != nullptr) {
+            isConverged = _newtonSolver->step();
+        } else if (_multigrid != nullptr) {
+            _multigrid->step();
+        } else {
+            step();
         }
 
-        // transfer
-        _grid->computeTransfer();
+        // values after each few steps are extrapolated over previous ones
+        if (_andersonMixer != nullptr && iteration % _config->getAndersonEachIteration() == 0) {
+            _andersonMixer->mix();
+        }
 
-        // check grid
-        _grid->check();
+        // stop early when moments don't change anymore
+        if (_residualMonitor != nullptr && iteration % _config->getResidualEachIteration() == 0) {
+            isConverged = _residualMonitor->update(iteration) || isConverged;
+        }
 
-        // print out results
-        if (iteration % _config->getOutEachIteration() == 0) {
+        // print out results, final results are always written
+        if (iteration % _config->getOutEachIteration() == 0 || isConverged) {
             writeResults(iteration);
         }
 
+        // save distribution functions to continue later
+        auto checkpointEachIteration = _config->getCheckpointEachIteration();
+        if (checkpointEachIteration != 0 && (iteration % checkpointEachIteration == 0 || isConverged)) {
+            ScopedTimer timer(Profiler::Phase::CHECKPOINT);
+            _checkpoint->write(iteration);
+        }
+        iterationTimer.stop();
+
+        // intermediate profile
+        auto profileEachIteration = _config->getProfileEachIteration();
+        if (Profiler::isEnabled() && profileEachIteration != 0 && iteration % profileEachIteration == 0) {
+            Profiler::report(iteration);
+        }
+
         if (Parallel::isMaster() == true) {
             bool isPrintingProgress = true;
             if (_keyboard->isAvailable()) {
@@ -129,43 +231,114 @@ void Solver::run() {
                 }
             }
             if (_keyboard->isAvailable() && _keyboard->isStop()) {
+                _writer->finish();
                 throw std::runtime_error("stop signal");
             }
         }
+
+        if (isConverged) {
+            lastIteration = iteration;
+            if (Parallel::isMaster() == true) {
+                std::cout << std::endl << "Converged at iteration " << iteration << std::endl;
+            }
+            break;
+        }
     }
+    // wait for snapshots still in queue
+    _writer->finish();
+
+    if (Profiler::isEnabled()) {
+        Profiler::reportTotal(lastIteration);
+    }
+    Tracer::write((boost::filesystem::path(_config->getOutputFolder()) / (_config->getName() + "_trace.json")).generic_string());
+
+    // collective, statistics of skipped and model collisions over ranks
+    std::vector<double> collisionsSizes;
+    if (_config->isUsingIntegral() && (_config->getCollisionSkipTolerance() > 0.0 || _config->getModelCollisionKnudsen() > 0.0)) {
+        collisionsSizes = {1.0 * _grid->getCollisionsSize(), 1.0 * _grid->getSkippedCollisionsSize(), 1.0 * _grid->getModelCollisionsSize()};
+        if (Parallel::isSingle() == false) {
+            collisionsSizes = Parallel::allReduce(collisionsSizes, Parallel::Reduce::SUM);
+        }
+    }
+
     if (Parallel::isMaster() == true) {
+        if (collisionsSizes.empty() == false) {
+            double totalSize = collisionsSizes[0] + collisionsSizes[1] + collisionsSizes[2];
+            auto getPercent = [totalSize](double size) {
+                return totalSize > 0.0 ? 100.0 * size / totalSize : 0.0;
+            };
+            std::cout << std::endl << "Collisions of " << totalSize << " cell integrals: skipped = " << collisionsSizes[1]
+                      << " (" << getPercent(collisionsSizes[1]) << "%); model = " << collisionsSizes[2]
+                      << " (" << getPercent(collisionsSizes[2]) << "%)" << std::endl;
+        }
+        if (_andersonMixer != nullptr) {
+            std::cout << std::endl << "Anderson mixes = " << _andersonMixer->getMixesSize()
+                      << "; restarts = " << _andersonMixer->getRestartsSize() << std::endl;
+        }
         std::cout << std::endl << "Done" << std::endl;
     }
 }
 
+void Solver::step() {
+
+    // each cell is checked right after its collisions and decay, border and parallel cells
+    // take values of normal cells
+    advance(true);
+}
+
+void Solver::advance(bool isChecking) {
+
+    // multirate grid goes with few substeps, each cell makes step on substeps of own level
+    for (unsigned int substep = 0; substep < _grid->getSubstepsSize(); substep++) {
+        _grid->beginSubstep(substep);
+
+        // transfer
+        _grid->computeTransfer();
+
+        // integral, beta decay and check
+        _grid->computeCellOperators(isChecking);
+
+        // transfer
+        _grid->computeTransfer();
+    }
+    _grid->endSubsteps();
+}
+
 void Solver::writeResults(int iteration) {
-    std::vector<CellResults*> results;
+    ScopedTimer timer(Profiler::Phase::OUTPUT);
+
+    // results are copied, so cells can go on while snapshot is written
+    std::vector<CellResults> results;
     for (const auto& cell : _grid->getCells()) {
         if (cell->getType() == NormalCell::Type::NORMAL) {
             auto normalCell = dynamic_cast<NormalCell*>(cell.get());
-            results.push_back(normalCell->getResults());
+            results.push_back(*normalCell->getResults());
         }
     }
 
+    // each rank writes own piece, no gathering on master
+    if (_formatter->isDistributed()) {
+        _writer->push(iteration, std::move(results));
+        return;
+    }
+
     if (Parallel::isSingle() == false) {
         if (Parallel::isMaster() == true) {
 
             // receive params from slaves, then unite grids
             for (int processor = 1; processor < Parallel::getSize(); processor++) {
-                std::vector<CellResults*> resultsBuffer;
+                std::vector<CellResults> resultsBuffer;
                 SerializationUtils::deserialize(Parallel::recv(processor, Parallel::COMMAND_RESULT_PARAMS), resultsBuffer);
-                for (auto tempResults : resultsBuffer) {
-                    results.push_back(tempResults);
-                }
+                results.insert(results.end(), resultsBuffer.begin(), resultsBuffer.end());
             }
 
-            _formatter->writeAll(iteration, _grid->getMesh(), results);
+            _writer->push(iteration, std::move(results));
         } else {
 
             // send params to master
             Parallel::send(SerializationUtils::serialize(results), 0, Parallel::COMMAND_RESULT_PARAMS);
         }
     } else {
-        _formatter->writeAll(iteration, _grid->getMesh(), results);
+        _writer->push(iteration, std::move(results));
     }
 }
@@ -5,25 +5,57 @@
 #include "parameters/ImpulseSphere.h"
 #include "grid/Grid.h"
 
+#include <memory>
+
 class NormalCell;
 class ResultsFormatter;
+class SnapshotWriter;
+class Checkpoint;
+class ResidualMonitor;
+class NewtonSolver;
+class AndersonMixer;
+class Multigrid;
+class Mesh;
 class KeyboardManager;
 
 class Solver {
 public:
     Solver();
 
+    ~Solver();
+
     void init();
 
     void run();
 
+    // master only, loads mesh and prints memory per rank without creating grid
+    void estimateMemory();
+
     void writeResults(int iteration);
 
 private:
+    // gmsh file or generated mesh, see MeshGenerator
+    Mesh* loadMesh();
+
+    // one time step: transfer, collisions, decay, transfer and check
+    void step();
+
+    // the same with check of cells on demand, newton and multigrid take it without check
+    // on trial values and check grid after own updates
+    void advance(bool isChecking);
+
     Config* _config;
     Grid* _grid;
-    ResultsFormatter* _formatter;
+    std::unique_ptr<ResultsFormatter> _formatter;
+    std::unique_ptr<SnapshotWriter> _writer;   // declared after formatter, so it is destroyed first
+    Checkpoint* _checkpoint;
+    ResidualMonitor* _residualMonitor;
+    NewtonSolver* _newtonSolver;        // steady solver instead of time steps
+    AndersonMixer* _andersonMixer;      // steady solver mixing time steps
+    Multigrid* _multigrid;              // steady solver correcting time steps on coarse grids
     KeyboardManager* _keyboard;
+
+    unsigned int _startIteration;
 };
 
 #endif //RGS_SOLVER_H
@@ -14,6 +14,14 @@ int main(int argc, char* argv[]) {
         Parallel::abort();
     }
 
+    // only estimate memory per rank, grid is not created
+    bool isDryRun = false;
+    for (int ai = 1; ai < argc - 1; ai++) {
+        if (std::string(argv[ai]) == "--dry-run") {
+            isDryRun = true;
+        }
+    }
+
     // Print off a hello world message
     if (Parallel::isMaster()) {
         std::cout << "Starting solver with " << Parallel::getSize() << " nodes" << std::endl << std::endl;
@@ -61,6 +69,11 @@ int main(int argc, char* argv[]) {
 
     try {
         Solver solver;
+        if (isDryRun == true) {
+            solver.estimateMemory();
+            Parallel::finalize();
+            return 0;
+        }
         solver.init();
 
         Parallel::barrier();
@@ -16,6 +16,11 @@ void BaseCell::check() {
 
     for (unsigned int gi = 0; gi < gases.size(); gi++) {
         for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+            if (std::isnan(_values[gi][ii])) {
+                std::string text = (boost::format("Values not a number: gi = %d; ii = %d; id = %d; type = %d")
+                                    % gi % ii % _id % Utils::asNumber(_type)).str();
+                throw std::runtime_error(text);
+            }
             if (_values[gi][ii] < -0.1) {
                 std::string text = (boost::format("Values below zero: gi = %d; ii = %d; value = %f; id = %d; type = %d")
                                     % gi % ii % _values[gi][ii] % _id % Utils::asNumber(_type)).str();
@@ -21,10 +21,9 @@ protected:
     int _id;
     std::vector<std::vector<double>> _values;
     std::vector<std::shared_ptr<CellConnection>> _connections;
-    bool _isImplicitTransferComputed;
 
 public:
-    BaseCell(Type type, int id) : _type(type), _id(id), _isImplicitTransferComputed(false) {}
+    BaseCell(Type type, int id) : _type(type), _id(id) {}
 
     int getId() const {
         return _id;
@@ -34,18 +33,6 @@ public:
         return _type;
     }
 
-    bool isImplicitTransferComputed() const {
-        return _isImplicitTransferComputed;
-    }
-
-    void setImplicitTransferComputed(bool isImplicitTransferComputed) {
-        _isImplicitTransferComputed = isImplicitTransferComputed;
-    }
-
-    void clearImplicitTransferFlag() {
-        _isImplicitTransferComputed = false;
-    }
-
     std::vector<std::vector<double>>& getValues() {
         return _values;
     }
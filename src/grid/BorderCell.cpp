@@ -2,6 +2,7 @@
 #include "CellConnection.h"
 #include "NormalCell.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 void BorderCell::init() {
@@ -15,12 +16,43 @@ void BorderCell::init() {
         _values[gi].resize(impulses.size(), 0.0);
     }
 
-    // cache exponent
-    _cacheExp.resize(gases.size());
+    // exponents of border temperature are shared with other cells
+    _maxwellians.resize(gases.size(), nullptr);
     for (unsigned int gi = 0; gi < gases.size(); gi++) {
-        _cacheExp[gi].resize(impulses.size(), 0.0);
-        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-            _cacheExp[gi][ii] = std::exp(-impulses[ii].moduleSquare() / gases[gi].getMass() / 2 / _boundaryParams.getTemp(gi));
+        _maxwellians[gi] = &_maxwellianCache->get(gi, _boundaryParams.getTemp(gi));
+    }
+
+    // wrong connections are reported by transfer
+    if (_connections.size() != 1) {
+        return;
+    }
+
+    // half spaces of impulses by normal, each transfer goes over own half only
+    const auto& normal = _connections[0]->getNormal12();
+    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+        double projection = impulses[ii].scalar(normal);
+        if (projection < 0.0) {
+            _outwardIndexes.push_back(ii);
+            _outwardProjections.push_back(-projection);
+        } else {
+            _inwardIndexes.push_back(ii);
+            _inwardProjections.push_back(projection);
+        }
+    }
+
+    // flows of exponents don't change, border temperature is fixed
+    _inwardFlows.resize(gases.size(), 0.0);
+    for (unsigned int gi = 0; gi < gases.size(); gi++) {
+        const auto& exponents = _maxwellians[gi]->values;
+        for (unsigned int k = 0; k < _inwardIndexes.size(); k++) {
+            _inwardFlows[gi] += _inwardProjections[k] * exponents[_inwardIndexes[k]];
+        }
+    }
+
+    if (std::find(_borderTypes.begin(), _borderTypes.end(), BorderType::MIRROR) != _borderTypes.end()) {
+        auto impulseSphere = config->getImpulseSphere();
+        for (auto ii : _inwardIndexes) {
+            _mirrorIndexes.push_back(impulseSphere->reverseIndex(ii, normal));
         }
     }
 }
@@ -73,167 +105,63 @@ void BorderCell::computeImplicitTransfer(int ii) {
     // nothing, all must be calculated before
 }
 
-void BorderCell::computeTransferDiffuse(unsigned int gi) {
-    auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    const auto& impulses = config->getImpulseSphere()->getImpulses();
+double BorderCell::computeOutwardFlow(unsigned int gi) {
+    const auto& values = _connections[0]->getSecond()->getValues()[gi];
 
-    double cUp = 0.0, cDown = 0.0;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-        if (projection < 0.0) {
-            cUp += -projection * _connections[0]->getSecond()->getValues()[gi][ii];
-        } else {
-            cDown += projection * _cacheExp[gi][ii];
-        }
+    double flow = 0.0;
+    for (unsigned int k = 0; k < _outwardIndexes.size(); k++) {
+        flow += _outwardProjections[k] * values[_outwardIndexes[k]];
     }
+    return flow;
+}
 
-    double h = cUp / cDown;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-        if (projection >= 0.0) {
-            _values[gi][ii] = h * _cacheExp[gi][ii];
-        }
+void BorderCell::setInwardValues(unsigned int gi, double factor) {
+    auto& values = _values[gi];
+    const auto& exponents = _maxwellians[gi]->values;
+    for (auto ii : _inwardIndexes) {
+        values[ii] = factor * exponents[ii];
     }
 }
 
+void BorderCell::computeTransferDiffuse(unsigned int gi) {
+    double cUp = computeOutwardFlow(gi);
+    double h = cUp / _inwardFlows[gi];
+    setInwardValues(gi, h);
+}
+
 void BorderCell::computeTransferMirror(unsigned int gi) {
-    auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    const auto& impulseSphere = config->getImpulseSphere();
-    const auto& impulses = impulseSphere->getImpulses();
+    const auto& values = _connections[0]->getSecond()->getValues()[gi];
 
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-        if (projection >= 0.0) {
-            auto rii = impulseSphere->reverseIndex(ii, _connections[0]->getNormal12());
-            if (rii >= 0) {
-                _values[gi][ii] = _connections[0]->getSecond()->getValues()[gi][rii];
-            } else {
-                _values[gi][ii] = 0.0;
-            }
-        }
+    for (unsigned int k = 0; k < _inwardIndexes.size(); k++) {
+        auto rii = _mirrorIndexes[k];
+        _values[gi][_inwardIndexes[k]] = rii >= 0 ? values[rii] : 0.0;
     }
 }
 
 void BorderCell::computeTransferPressure(unsigned int gi, double borderPressure) {
     auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    const auto& impulseSphere = config->getImpulseSphere();
-    const auto& impulses = impulseSphere->getImpulses();
 
-    double coeff = 0.0;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        coeff += _cacheExp[gi][ii];
-    }
-    coeff = 1.0 / coeff;
+    double coeff = 1.0 / _maxwellians[gi]->sum;
     coeff *= borderPressure / _boundaryParams.getTemp(gi) / config->getImpulseSphere()->getDeltaImpulseQube();
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-        if (projection >= 0.0) {
-            _values[gi][ii] = coeff * _cacheExp[gi][ii];
-        }
-    }
-
-//    if (borderPressure > 0) {
-//        borderPressure /= _boundaryParams.getTemp(gi) * impulseSphere->getDeltaImpulseQube();
-//    }
-//    double cUp = borderPressure, cDown = 0.0;
-//    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-//        double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-//        if (projection< 0.0) {
-//            cUp -= _connections[0]->getSecond()->getValues()[gi][ii];
-//        } else {
-//            cDown += _cacheExp[gi][ii];
-//        }
-//    }
-//
-//    double h = cUp / cDown;
-//    if (h > 0) {
-//        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-//            double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-//            if (projection >= 0.0) {
-//                _values[gi][ii] = h * _cacheExp[gi][ii];
-//            }
-//        }
-//    } else {
-//        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-//            double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-//            if (projection >= 0.0) {
-//                _values[gi][ii] = 0.0;
-//            }
-//        }
-//    }
+    setInwardValues(gi, coeff);
 }
 
 void BorderCell::computeTransferFlow(unsigned int gi, double borderFlow) {
-    auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    const auto& impulseSphere = config->getImpulseSphere();
-    const auto& impulses = impulseSphere->getImpulses();
-
-    double cUp = 0.0, cDown = 0.0;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-        if (projection < 0.0) {
-            cUp += -projection * _connections[0]->getSecond()->getValues()[gi][ii];
-        } else {
-            cDown += projection * _cacheExp[gi][ii];
-        }
-    }
+    auto impulseSphere = Config::getInstance()->getImpulseSphere();
 
     // add flow from border to output
-    double h = (cUp + borderFlow / impulseSphere->getDeltaImpulseQube()) / cDown;
-    if (h > 0) {
-        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-            double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-            if (projection >= 0.0) {
-                _values[gi][ii] = h * _cacheExp[gi][ii];
-            }
-        }
-    } else {
-        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-            double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-            if (projection >= 0.0) {
-                _values[gi][ii] = 0.0;
-            }
-        }
-    }
+    double cUp = computeOutwardFlow(gi);
+    double h = (cUp + borderFlow / impulseSphere->getDeltaImpulseQube()) / _inwardFlows[gi];
+    setInwardValues(gi, h > 0 ? h : 0.0);
 }
 
 double BorderCell::computeTransferFlowConnect(unsigned int gi, double borderFlow) {
-    auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    const auto& impulseSphere = config->getImpulseSphere();
-    const auto& impulses = impulseSphere->getImpulses();
-
-    double cUp = 0.0, cDown = 0.0;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-        if (projection < 0.0) {
-            cUp += -projection * _connections[0]->getSecond()->getValues()[gi][ii];
-        } else {
-            cDown += projection * _cacheExp[gi][ii];
-        }
-    }
+    auto impulseSphere = Config::getInstance()->getImpulseSphere();
 
     // add flow from border to output
-    double h = (borderFlow / impulseSphere->getDeltaImpulseQube()) / cDown;
-    if (h > 0) {
-        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-            double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-            if (projection >= 0.0) {
-                _values[gi][ii] = h * _cacheExp[gi][ii];
-            }
-        }
-    } else {
-        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-            double projection = impulses[ii].scalar(_connections[0]->getNormal12());
-            if (projection >= 0.0) {
-                _values[gi][ii] = 0.0;
-            }
-        }
-    }
+    double cUp = computeOutwardFlow(gi);
+    double h = (borderFlow / impulseSphere->getDeltaImpulseQube()) / _inwardFlows[gi];
+    setInwardValues(gi, h > 0 ? h : 0.0);
 
     return cUp * impulseSphere->getDeltaImpulseQube();
 }
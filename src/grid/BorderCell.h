@@ -4,6 +4,7 @@
 #include "BaseCell.h"
 #include "CellParameters.h"
 #include "GridBuffer.h"
+#include "MaxwellianCache.h"
 
 class BorderCell : public BaseCell {
 public:
@@ -21,15 +22,26 @@ private:
     CellParameters _boundaryParams;
 
     GridBuffer* _gridBuffer;
+    MaxwellianCache* _maxwellianCache;
 
     // needed for flow connect condition
     std::string _group;
     std::string _groupConnect;
 
-    std::vector<std::vector<double>> _cacheExp;
+    std::vector<const MaxwellianCache::Table*> _maxwellians;   // of border temperature of each gas
+
+    // impulses into the grid go from border, ones out of the grid come from normal cell,
+    // projections onto normal are taken by modulus
+    std::vector<unsigned int> _inwardIndexes;
+    std::vector<double> _inwardProjections;
+    std::vector<unsigned int> _outwardIndexes;
+    std::vector<double> _outwardProjections;
+    std::vector<double> _inwardFlows;       // of maxwellian exponents of each gas
+    std::vector<int> _mirrorIndexes;        // reversed inward impulses, -1 beyond sphere, mirror borders only
 
 public:
-    explicit BorderCell(int id, GridBuffer* gridBuffer) : BaseCell(Type::BORDER, id), _gridBuffer(gridBuffer) {
+    BorderCell(int id, GridBuffer* gridBuffer, MaxwellianCache* maxwellianCache)
+            : BaseCell(Type::BORDER, id), _gridBuffer(gridBuffer), _maxwellianCache(maxwellianCache) {
         const auto& gases = Config::getInstance()->getGases();
         _borderTypes.resize(gases.size(), BorderType::UNDEFINED);
     }
@@ -38,15 +50,51 @@ public:
         _borderTypes[gi] = borderType;
     }
 
+    BorderType getBorderType(int gi) const {
+        return _borderTypes[gi];
+    }
+
     CellParameters& getBoundaryParams() {
         return _boundaryParams;
     }
 
+    const std::vector<const MaxwellianCache::Table*>& getMaxwellians() const {
+        return _maxwellians;
+    }
+
+    const std::vector<unsigned int>& getInwardIndexes() const {
+        return _inwardIndexes;
+    }
+
+    const std::vector<double>& getInwardProjections() const {
+        return _inwardProjections;
+    }
+
+    const std::vector<unsigned int>& getOutwardIndexes() const {
+        return _outwardIndexes;
+    }
+
+    const std::vector<double>& getOutwardProjections() const {
+        return _outwardProjections;
+    }
+
+    const std::vector<int>& getMirrorIndexes() const {
+        return _mirrorIndexes;
+    }
+
     void setConnectParams(std::string group, std::string groupConnect) {
         _group = std::move(group);
         _groupConnect = std::move(groupConnect);
     }
 
+    const std::string& getGroup() const {
+        return _group;
+    }
+
+    const std::string& getGroupConnect() const {
+        return _groupConnect;
+    }
+
     void init() override;
 
     void computeTransfer() override;
@@ -58,6 +106,12 @@ public:
     void computeImplicitTransfer(int ii) override;
 
 private:
+    // flow out of the grid by values of normal cell
+    double computeOutwardFlow(unsigned int gi);
+
+    // inward values are maxwellian exponents times factor
+    void setInwardValues(unsigned int gi, double factor);
+
     void computeTransferDiffuse(unsigned int gi);
     void computeTransferMirror(unsigned int gi);
     void computeTransferPressure(unsigned int gi, double borderPressure);
@@ -3,7 +3,10 @@
 
 #include <utilities/Types.h>
 
+#include <memory>
+
 class BaseCell;
+class FluxRegister;
 
 class CellConnection {
 private:
@@ -14,6 +17,8 @@ private:
     Vector3d _normal12;
     Vector3d _normal21;
 
+    std::shared_ptr<FluxRegister> _fluxRegister;    // only between normal cells of different multirate levels
+
 public:
     CellConnection(BaseCell* first, BaseCell* second, double square, const Vector3d& normal12)
     : _first(first), _second(second), _square(square), _normal12(normal12), _normal21(-normal12) {}
@@ -38,6 +43,14 @@ public:
         return _normal21;
     }
 
+    FluxRegister* getFluxRegister() const {
+        return _fluxRegister.get();
+    }
+
+    void setFluxRegister(const std::shared_ptr<FluxRegister>& fluxRegister) {
+        _fluxRegister = fluxRegister;
+    }
+
 };
 
 
@@ -0,0 +1,13 @@
+#include "FluxRegister.h"
+#include "NormalCell.h"
+
+void FluxRegister::apply() {
+    auto& values = _coarseCell->getValues();
+    double volume = _coarseCell->getVolume();
+    for (unsigned int gi = 0; gi < _values.size(); gi++) {
+        for (unsigned int ii = 0; ii < _values[gi].size(); ii++) {
+            values[gi][ii] += _values[gi][ii] / volume;
+            _values[gi][ii] = 0.0;
+        }
+    }
+}
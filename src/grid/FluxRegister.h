@@ -0,0 +1,33 @@
+#ifndef RGS_FLUXREGISTER_H
+#define RGS_FLUXREGISTER_H
+
+#include <vector>
+
+class NormalCell;
+
+// Face between cells of different multirate levels. Both cells subtract mass they take
+// through face, so sum is mass which coarse cell misses against fine cell substeps.
+// It is given back to coarse cell when both cells come to the same time.
+class FluxRegister {
+private:
+    NormalCell* _coarseCell;
+    std::vector<std::vector<double>> _values;   // for each gas and impulse, in values multiplied by volume units
+
+public:
+    FluxRegister(NormalCell* coarseCell, unsigned int gasesSize, unsigned int impulsesSize)
+    : _coarseCell(coarseCell), _values(gasesSize, std::vector<double>(impulsesSize, 0.0)) {}
+
+    NormalCell* getCoarseCell() const {
+        return _coarseCell;
+    }
+
+    void add(unsigned int gi, unsigned int ii, double value) {
+        _values[gi][ii] += value;
+    }
+
+    // adds missed mass to coarse cell values and clears register
+    void apply();
+
+};
+
+#endif //RGS_FLUXREGISTER_H
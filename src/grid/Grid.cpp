@@ -3,7 +3,11 @@
 #include "BorderCell.h"
 #include "ParallelCell.h"
 #include "CellConnection.h"
+#include "FluxRegister.h"
+#include "SweepSchedule.h"
+#include "integral/SpectralCollisions.h"
 #include "mesh/Mesh.h"
+#include "parameters/BetaChain.h"
 #include "parameters/Gas.h"
 #include "parameters/ImpulseSphere.h"
 #include "parameters/InitialParameters.h"
@@ -11,6 +15,7 @@
 #include "utilities/Parallel.h"
 #include "utilities/SerializationUtils.h"
 #include "utilities/Normalizer.h"
+#include "utilities/Profiler.h"
 #include "integral/ci.hpp"
 #include "integral/ci_impl.hpp"
 
@@ -19,7 +24,7 @@
 
 #include <unistd.h>
 
-Grid::Grid(Mesh* mesh) : _mesh(mesh), _buffer(new GridBuffer()) {
+Grid::Grid(Mesh* mesh) : _mesh(mesh), _buffer(new GridBuffer()), _maxwellianCache(new MaxwellianCache()), _isClosed(false), _isConservingMass(false), _substepsSize(1), _isCollisionsFrozen(false), _collisionsSize(0), _skippedCollisionsSize(0), _modelCollisionsSize(0) {
     auto config = Config::getInstance();
     const auto& initialParameters = config->getInitialParameters();
     const auto& boundaryParameters = config->getBoundaryParameters();
@@ -34,7 +39,7 @@ Grid::Grid(Mesh* mesh) : _mesh(mesh), _buffer(new GridBuffer()) {
             // create normal cell
             double volume = element->getVolume();
             normalizeVolume(element.get(), volume);
-            auto cell = new NormalCell(element->getId(), volume);
+            auto cell = new NormalCell(element->getId(), volume, _maxwellianCache.get());
             addCell(cell);
 
             // set initial params by physical group
@@ -54,6 +59,9 @@ Grid::Grid(Mesh* mesh) : _mesh(mesh), _buffer(new GridBuffer()) {
                             temperature = param.getGradientTemperature(gi).getValue(element->getCenter());
                         } else {
                             temperature = param.getTemperature(gi);
+
+                            // uniform temperature is shared by cells of group, so its maxwellian is kept
+                            _maxwellianCache->get(gi, temperature);
                         }
                         cell->getParams().setTemp(gi, temperature);
                     }
@@ -108,7 +116,7 @@ Grid::Grid(Mesh* mesh) : _mesh(mesh), _buffer(new GridBuffer()) {
             } else if (neighborElement->isBorder()) {
 
                 // create border cell
-                auto borderCell = new BorderCell(neighborElement->getId(), _buffer.get());
+                auto borderCell = new BorderCell(neighborElement->getId(), _buffer.get(), _maxwellianCache.get());
                 addCell(borderCell);
 
                 // set boundary params by physical group
@@ -210,18 +218,17 @@ void Grid::init() {
         cell->init();
     }
 
-    double minStep = std::numeric_limits<double>::max();
-    for (const auto& cell : _cells) {
-        if (cell->getType() == BaseCell::Type::NORMAL) {
-            auto normalCell = dynamic_cast<NormalCell*>(cell.get());
-
-            double maxSquare = 0.0;
-            for (const auto& connection : normalCell->getConnections()) {
-                maxSquare = std::max(connection->getSquare(), maxSquare);
-            }
-            double step = normalCell->getVolume() / maxSquare;
-            minStep = std::min(minStep, step);
+    auto getStep = [](NormalCell* normalCell) {
+        double maxSquare = 0.0;
+        for (const auto& connection : normalCell->getConnections()) {
+            maxSquare = std::max(connection->getSquare(), maxSquare);
         }
+        return normalCell->getVolume() / maxSquare;
+    };
+
+    double minStep = std::numeric_limits<double>::max();
+    for (const auto& normalCell : _normalCells) {
+        minStep = std::min(minStep, getStep(normalCell));
     }
 
     auto config = Config::getInstance();
@@ -252,6 +259,94 @@ void Grid::init() {
 
     config->setTimestep(timestep);
 
+    // spectral kernels go for whole grid, they depend on impulse sphere only
+    if (config->isUsingIntegral()) {
+        for (const auto& pair : config->getSpectralPairs()) {
+            auto key = std::make_pair(std::min(pair[0], pair[1]), std::max(pair[0], pair[1]));
+            if (_spectralCollisions.count(key) == 0) {
+                _spectralCollisions[key] = std::make_shared<SpectralCollisions>(key.first, key.second, config->getSpectralAngles());
+            }
+        }
+    }
+
+    // local time stepping: each cell goes with own stable step, so only steady state is valid
+    std::vector<double> scales = {std::numeric_limits<double>::max(), 0.0};
+    if (config->isUsingLocalTimestep()) {
+        for (const auto& normalCell : _normalCells) {
+            double scale = 0.95 * 2 * getStep(normalCell) * minMass / config->getImpulseSphere()->getMaxImpulse() / timestep;
+            if (config->getLocalTimestepMaxScale() > 0.0) {
+                scale = std::min(scale, config->getLocalTimestepMaxScale());
+            }
+            scale = std::max(scale, 1.0);
+            normalCell->setTimestepScale(scale);
+            scales[0] = std::min(scales[0], scale);
+            scales[1] = std::max(scales[1], scale);
+        }
+        if (Parallel::isSingle() == false) {
+            scales[0] = Parallel::allReduce({scales[0]}, Parallel::Reduce::MIN)[0];
+            scales[1] = Parallel::allReduce({scales[1]}, Parallel::Reduce::MAX)[0];
+        }
+    }
+
+    // walls only, any inflow or outflow defines mass itself
+    std::vector<double> isClosed = {config->isUsingBetaDecay() ? 0.0 : 1.0};
+    for (const auto& borderCell : _borderCells) {
+        for (unsigned int gi = 0; gi < config->getGases().size(); gi++) {
+            auto borderType = borderCell->getBorderType(gi);
+            if (borderType != BorderCell::BorderType::DIFFUSE && borderType != BorderCell::BorderType::MIRROR) {
+                isClosed[0] = 0.0;
+            }
+        }
+    }
+    if (Parallel::isSingle() == false) {
+        isClosed = Parallel::allReduce(isClosed, Parallel::Reduce::MIN);
+    }
+    _isClosed = isClosed[0] > 0.0;
+    _isConservingMass = config->isUsingLocalTimestep() && _isClosed;
+
+    // multirate time stepping: cells go with own stable step rounded down to power of two, so transients stay valid
+    _activeNormalCells = _normalCells;
+    _activeBorderCells = _borderCells;
+    if (config->isUsingMultirateTimestep()) {
+        if (config->isUsingLocalTimestep() || config->isImplicitScheme()) {
+            throw std::runtime_error("multirate timestep goes with explicit scheme and global timestep only");
+        }
+        std::vector<double> stepScales;
+        for (const auto& normalCell : _normalCells) {
+            stepScales.push_back(0.95 * 2 * getStep(normalCell) * minMass / config->getImpulseSphere()->getMaxImpulse() / timestep);
+        }
+        initMultirate(stepScales);
+    }
+
+    // upwind orders don't change, so they are found once, steady solver takes sweeps for preconditioner
+    if (config->isImplicitScheme() || config->getSteadySolver() == "jfnk") {
+        std::map<int, std::vector<int>> sendSyncIdsMap;
+        std::map<int, std::vector<int>> recvSyncIdsMap;
+        getSyncIds(sendSyncIdsMap, recvSyncIdsMap);
+
+        std::map<int, std::vector<BaseCell*>> sendCells;
+        std::map<int, std::vector<BaseCell*>> recvCells;
+        for (const auto& pair : sendSyncIdsMap) {
+            for (auto sendSyncId : pair.second) {
+                sendCells[pair.first].push_back(getCellById(sendSyncId));
+            }
+        }
+        for (const auto& pair : recvSyncIdsMap) {
+            for (auto recvSyncId : pair.second) {
+                recvCells[pair.first].push_back(getCellById(-recvSyncId));
+            }
+        }
+
+        _sweepSchedule.reset(new SweepSchedule(_normalCells, sendCells, recvCells, config->getSweepThreads()));
+        if (Parallel::isMaster()) {
+            std::cout << "Sweep groups = " << _sweepSchedule->getGroups().size()
+                      << "; orders = " << _sweepSchedule->getOrders().size()
+                      << "; lagged cells = " << _sweepSchedule->getLaggedSize()
+                      << "; lagged ranks = " << _sweepSchedule->getLaggedRanksSize()
+                      << "; threads = " << _sweepSchedule->getThreadsSize() << std::endl;
+        }
+    }
+
     if (Parallel::isMaster()) {
         std::cout << "MinMass = " << minMass << std::endl;
         std::cout << "MinStep = " << minStep << std::endl;
@@ -259,15 +354,27 @@ void Grid::init() {
 
         config->getNormalizer()->restore(timestep, Normalizer::Type::TIME);
         std::cout << "Timestep (Normalized) = " << timestep  << " seconds" << std::endl;
+
+        if (config->isUsingLocalTimestep()) {
+            std::cout << "Local timestep scale = " << scales[0] << " - " << scales[1]
+                      << (_isConservingMass ? "; mass is conserved" : "") << std::endl;
+        }
     }
 }
 
 void Grid::computeTransfer() {
     auto config = Config::getInstance();
+
+    // mass of initial or restored values
+    if (_isConservingMass && _masses.empty()) {
+        _masses = computeMasses();
+    }
+
     if (config->isImplicitScheme() == false) {
 
         // sync grid
         if (Parallel::isSingle() == false) {
+            ScopedTimer timer(Profiler::Phase::SYNC);
             sync();
         }
 
@@ -275,43 +382,146 @@ void Grid::computeTransfer() {
         _buffer->clearAllFlows();
 
         // first go for border cells
-        for (const auto& cell : _borderCells) {
-            cell->computeTransfer();
+        {
+            ScopedTimer timer(Profiler::Phase::BORDER);
+            for (const auto& cell : _activeBorderCells) {
+                cell->computeTransfer();
+            }
         }
 
         // calculate average flow
-        _buffer->calculateAverageFlow();
+        {
+            ScopedTimer timer(Profiler::Phase::AVERAGE_FLOW);
+            _buffer->calculateAverageFlow();
+        }
+
+        ScopedTimer timer(Profiler::Phase::TRANSFER);
 
         // then go for normal cells
-        for (const auto& cell : _normalCells) {
+        for (const auto& cell : _activeNormalCells) {
             cell->computeTransfer();
         }
 
         // move changes from next step to current step
-        for (const auto& cell : _normalCells) {
+        for (const auto& cell : _activeNormalCells) {
             cell->swapValues();
         }
+
+        if (_isConservingMass) {
+            scaleMasses(_masses);
+        }
     } else {
 
         // first go for border cells
-        for (const auto& cell : _borderCells) {
-            cell->computeTransfer();
+        {
+            ScopedTimer timer(Profiler::Phase::BORDER);
+            for (const auto& cell : _borderCells) {
+                cell->computeTransfer();
+            }
+        }
+
+        ScopedTimer timer(Profiler::Phase::TRANSFER);
+
+        // lagged ranks take values of previous step
+        if (Parallel::isSingle() == false && _sweepSchedule->getLaggedRanksSize() != 0) {
+            ScopedTimer timer(Profiler::Phase::SYNC);
+            sync();
+        }
+
+        // each cell goes after its upwind neighbors, ranks get values of upwind ranks on the way
+        _sweepSchedule->compute();
+
+        if (_isConservingMass) {
+            scaleMasses(_masses);
+        }
+    }
+}
+
+void Grid::computeCellOperators(bool isChecking) {
+    auto config = Config::getInstance();
+
+    // the same pairs as one by one sweeps took, collisions of gas with itself go first
+    std::vector<std::pair<unsigned int, unsigned int>> pairs;
+    if (config->isUsingIntegral()) {
+        pairs = config->getCollisionPairs();
+    }
+    std::vector<SpectralCollisions*> spectralCollisions;
+    for (const auto& pair : pairs) {
+        auto found = _spectralCollisions.find(pair);
+        spectralCollisions.push_back(found != _spectralCollisions.end() ? found->second.get() : nullptr);
+    }
+    double modelKnudsen = config->getModelCollisionKnudsen();
+    std::vector<BetaChain> noBetaChains;
+    const auto& betaChains = config->isUsingBetaDecay() ? config->getBetaChains() : noBetaChains;
+
+    // cells take model of gas with itself by knudsen before any collisions of the cell,
+    // so choice is made before sweep
+    std::vector<std::vector<bool>> isModel(pairs.size());
+    for (unsigned int pi = 0; pi < pairs.size(); pi++) {
+        unsigned int gi1 = pairs[pi].first, gi2 = pairs[pi].second;
+        isModel[pi].resize(_activeNormalCells.size(), false);
+        if (gi1 != gi2 || modelKnudsen <= 0.0) {
+            continue;
         }
+        for (unsigned int ci = 0; ci < _activeNormalCells.size(); ci++) {
+            auto cell = _activeNormalCells[ci];
+            isModel[pi][ci] = cell->isCollisionSkipped() == false && cell->computeKnudsen(gi1) < modelKnudsen;
+        }
+    }
 
-        // implicitly recursive iterate over all cells
-        const auto& impulses = config->getImpulseSphere()->getImpulses();
-        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-            for (const auto& cell : _normalCells) {
-                cell->clearImplicitTransferFlag();
+    // nodes of each pair which some cell needs are generated before sweep in order of pairs,
+    // so korobov nodes are the same as in one by one sweeps, and none when all cells are near equilibrium
+    ScopedTimer timer(Profiler::Phase::CELL_OPERATORS);
+    std::vector<std::vector<ci::node_calc>> nodes(pairs.size());
+    for (unsigned int pi = 0; pi < pairs.size(); pi++) {
+        if (spectralCollisions[pi] != nullptr) {
+            continue;
+        }
+        for (unsigned int ci = 0; ci < _activeNormalCells.size(); ci++) {
+            if (_activeNormalCells[ci]->isCollisionSkipped() == false && isModel[pi][ci] == false) {
+                prepareCollisions(pairs[pi].first, pairs[pi].second);
+                std::swap(nodes[pi], ci::nc);
+                break;
             }
-            for (const auto& cell : _normalCells) {
-                cell->computeImplicitTransfer(ii);
+        }
+    }
+
+    // each cell takes all operators while its values are in cache
+    for (unsigned int ci = 0; ci < _activeNormalCells.size(); ci++) {
+        auto cell = _activeNormalCells[ci];
+        for (unsigned int pi = 0; pi < pairs.size(); pi++) {
+            unsigned int gi1 = pairs[pi].first, gi2 = pairs[pi].second;
+            if (cell->isCollisionSkipped()) {
+                _skippedCollisionsSize++;
+            } else if (isModel[pi][ci]) {
+                _modelCollisionsSize++;
+                cell->computeModelIntegral(gi1);
+            } else if (spectralCollisions[pi] != nullptr) {
+                _collisionsSize++;
+                auto& values = cell->getValues();
+                spectralCollisions[pi]->compute(values[gi1], values[gi2], cell->getTimestepScale());
+            } else {
+                _collisionsSize++;
+                cell->computeIntegral(nodes[pi], gi1, gi2);
             }
         }
+        for (const auto& betaChain : betaChains) {
+            cell->computeBetaDecay(betaChain.getGasIndex1(), betaChain.getGasIndex2(), betaChain.getLambda1());
+            cell->computeBetaDecay(betaChain.getGasIndex2(), betaChain.getGasIndex3(), betaChain.getLambda2());
+        }
+        if (isChecking) {
+            cell->check();
+        }
+    }
+}
+
+void Grid::updateCollisionSkipping(double tolerance) {
+    for (const auto& cell : _normalCells) {
+        cell->setCollisionSkipped(cell->computeNonEquilibrium() < tolerance);
     }
 }
 
-void Grid::computeIntegral(unsigned int gi1, unsigned int gi2) {
+void Grid::prepareCollisions(unsigned int gi1, unsigned int gi2) {
     auto impulse = Config::getInstance()->getImpulseSphere();
     const auto& gases = Config::getInstance()->getGases();
     double timestep = Config::getInstance()->getTimestep();
@@ -323,25 +533,57 @@ void Grid::computeIntegral(unsigned int gi1, unsigned int gi2) {
     particle1.d = gases[gi1].getRadius();
     particle2.d = gases[gi2].getRadius();
 
-    ci::gen(timestep, 50000,
-            impulse->getResolution() / 2, impulse->getResolution() / 2,
-            impulse->getXYZ2I(), impulse->getXYZ2I(),
-            impulse->getDeltaImpulse(),
-            gases[gi1].getMass(), gases[gi2].getMass(),
-            particle1, particle2);
-
-    for (const auto& cell : _normalCells) {
-        cell->computeIntegral(gi1, gi2);
+    auto key = std::make_pair(gi1, gi2);
+    if (_isCollisionsFrozen && _collisionNodes.count(key) != 0) {
+        ci::nc = *_collisionNodes[key];
+    } else {
+        ScopedTimer timer(Profiler::Phase::COLLISION_GEN);
+        ci::gen(timestep, 50000,
+                impulse->getResolution() / 2, impulse->getResolution() / 2,
+                impulse->getXYZ2I(), impulse->getXYZ2I(),
+                impulse->getDeltaImpulse(),
+                gases[gi1].getMass(), gases[gi2].getMass(),
+                particle1, particle2);
+        if (_isCollisionsFrozen) {
+            _collisionNodes[key] = std::make_shared<std::vector<ci::node_calc>>(ci::nc);
+        }
     }
 }
 
-void Grid::computeBetaDecay(unsigned int gi0, unsigned int gi1, double lambda) {
-    for (const auto& cell : _normalCells) {
-        cell->computeBetaDecay(gi0, gi1, lambda);
+void Grid::setCollisionsFrozen(bool isCollisionsFrozen) {
+    _isCollisionsFrozen = isCollisionsFrozen;
+    _collisionNodes.clear();
+}
+
+void Grid::computeImplicitSweep(double timestepScale) {
+    if (_sweepSchedule == nullptr) {
+        throw std::runtime_error("implicit sweep is not initialized");
+    }
+
+    // border values are swapped out for zeros, so sweep is linear in values
+    std::vector<std::vector<std::vector<double>>> borderValues(_borderCells.size());
+    for (unsigned int bi = 0; bi < _borderCells.size(); bi++) {
+        auto& values = _borderCells[bi]->getValues();
+        borderValues[bi].resize(values.size(), std::vector<double>(values.empty() ? 0 : values.front().size(), 0.0));
+        std::swap(values, borderValues[bi]);
+    }
+
+    if (Parallel::isSingle() == false && _sweepSchedule->getLaggedRanksSize() != 0) {
+        ScopedTimer timer(Profiler::Phase::SYNC);
+        sync();
+    }
+    {
+        ScopedTimer timer(Profiler::Phase::TRANSFER);
+        _sweepSchedule->compute(timestepScale);
+    }
+
+    for (unsigned int bi = 0; bi < _borderCells.size(); bi++) {
+        std::swap(_borderCells[bi]->getValues(), borderValues[bi]);
     }
 }
 
 void Grid::check() {
+    ScopedTimer timer(Profiler::Phase::CHECK);
     for (const auto& cell : _cells) {
         cell->check();
     }
@@ -350,7 +592,55 @@ void Grid::check() {
 void Grid::sync() {
     std::map<int, std::vector<int>> sendSyncIdsMap;
     std::map<int, std::vector<int>> recvSyncIdsMap;
+    getSyncIds(sendSyncIdsMap, recvSyncIdsMap);
+
+//    for (const auto& pair : sendSyncIdsMap) {
+//        std::cout << "Send to process: " << pair.first << std::endl;
+//        for (const auto& sendSyncId : pair.second) {
+//            std::cout << sendSyncId << " ";
+//        }
+//        std::cout << std::endl;
+//    }
+//
+//    for (const auto& pair : recvSyncIdsMap) {
+//        std::cout << "Recv from process: " << pair.first << std::endl;
+//        for (const auto& recvSyncId : pair.second) {
+//            std::cout << recvSyncId << " ";
+//        }
+//        std::cout << std::endl;
+//    }
 
+    // send and recv
+    for (auto rank = 0; rank < Parallel::getSize(); rank++) {
+        if (rank == Parallel::getRank()) {
+            // recv
+            for (auto otherRank = 0; otherRank < Parallel::getSize(); otherRank++) {
+                if (otherRank != rank) {
+                    if (recvSyncIdsMap.count(otherRank) != 0) {
+                        TraceScope trace("sync_recv", otherRank);
+                        const auto& recvSyncIds = recvSyncIdsMap[otherRank];
+                        for (auto recvSyncId : recvSyncIds) {
+                            auto cell = getCellById(-recvSyncId);
+                            SerializationUtils::deserialize(Parallel::recv(otherRank, Parallel::COMMAND_SYNC_VALUES), cell->getValues());
+                        }
+                    }
+                }
+            }
+        } else {
+            // send to rank process
+            if (sendSyncIdsMap.count(rank) != 0) {
+                TraceScope trace("sync_send", rank);
+                const auto& sendSyncIds = sendSyncIdsMap[rank];
+                for (auto sendSyncId : sendSyncIds) {
+                    auto cell = getCellById(sendSyncId);
+                    Parallel::send(SerializationUtils::serialize(cell->getValues()), rank, Parallel::COMMAND_SYNC_VALUES);
+                }
+            }
+        }
+    }
+}
+
+void Grid::getSyncIds(std::map<int, std::vector<int>>& sendSyncIdsMap, std::map<int, std::vector<int>>& recvSyncIdsMap) const {
     // fill map
     for (const auto& cell : _parallelCells) {
 
@@ -384,49 +674,162 @@ void Grid::sync() {
         std::sort(recvSyncIds.begin(), recvSyncIds.end());
         recvSyncIds.erase(std::unique(recvSyncIds.begin(), recvSyncIds.end()), recvSyncIds.end());
     }
+}
 
-//    for (const auto& pair : sendSyncIdsMap) {
-//        std::cout << "Send to process: " << pair.first << std::endl;
-//        for (const auto& sendSyncId : pair.second) {
-//            std::cout << sendSyncId << " ";
-//        }
-//        std::cout << std::endl;
-//    }
-//
-//    for (const auto& pair : recvSyncIdsMap) {
-//        std::cout << "Recv from process: " << pair.first << std::endl;
-//        for (const auto& recvSyncId : pair.second) {
-//            std::cout << recvSyncId << " ";
-//        }
-//        std::cout << std::endl;
-//    }
+std::map<int, unsigned int> Grid::syncLevels() {
+    std::map<int, std::vector<int>> sendSyncIdsMap;
+    std::map<int, std::vector<int>> recvSyncIdsMap;
+    getSyncIds(sendSyncIdsMap, recvSyncIdsMap);
 
-    // send and recv
+    // one message for each pair of ranks, levels go in order of sorted ids
+    std::map<int, unsigned int> levels;
     for (auto rank = 0; rank < Parallel::getSize(); rank++) {
         if (rank == Parallel::getRank()) {
-            // recv
-            for (auto otherRank = 0; otherRank < Parallel::getSize(); otherRank++) {
-                if (otherRank != rank) {
-                    if (recvSyncIdsMap.count(otherRank) != 0) {
-                        const auto& recvSyncIds = recvSyncIdsMap[otherRank];
-                        for (auto recvSyncId : recvSyncIds) {
-                            auto cell = getCellById(-recvSyncId);
-                            SerializationUtils::deserialize(Parallel::recv(otherRank, Parallel::COMMAND_SYNC_VALUES), cell->getValues());
+            for (const auto& pair : recvSyncIdsMap) {
+                std::vector<unsigned int> recvLevels;
+                SerializationUtils::deserialize(Parallel::recv(pair.first, Parallel::COMMAND_SYNC_LEVELS), recvLevels);
+                for (unsigned int si = 0; si < pair.second.size(); si++) {
+                    levels[-pair.second[si]] = recvLevels[si];
+                }
+            }
+        } else if (sendSyncIdsMap.count(rank) != 0) {
+            std::vector<unsigned int> sendLevels;
+            for (auto sendSyncId : sendSyncIdsMap[rank]) {
+                sendLevels.push_back(dynamic_cast<NormalCell*>(getCellById(sendSyncId))->getTimestepLevel());
+            }
+            Parallel::send(SerializationUtils::serialize(sendLevels), rank, Parallel::COMMAND_SYNC_LEVELS);
+        }
+    }
+    return levels;
+}
+
+void Grid::initMultirate(const std::vector<double>& scales) {
+    auto config = Config::getInstance();
+    const auto& gases = config->getGases();
+    const auto& impulses = config->getImpulseSphere()->getImpulses();
+
+    // largest power of two which own stable step holds
+    unsigned int maxLevel = 0;
+    for (unsigned int ci = 0; ci < _normalCells.size(); ci++) {
+        unsigned int level = 0;
+        while (level < config->getMultirateMaxLevel() && (1u << (level + 1)) <= scales[ci]) {
+            level++;
+        }
+        _normalCells[ci]->setTimestepLevel(level);
+    }
+
+    // cells on both sides of ranks border go with the same level, so fluxes between ranks need no registers
+    if (Parallel::isSingle() == false) {
+        bool isChanged = true;
+        while (isChanged) {
+            auto parallelLevels = syncLevels();
+            std::vector<double> changes = {0.0};
+            for (const auto& normalCell : _normalCells) {
+                for (const auto& connection : normalCell->getConnections()) {
+                    if (connection->getSecond()->getType() == BaseCell::Type::PARALLEL) {
+                        auto parallelLevel = parallelLevels[connection->getSecond()->getId()];
+                        if (parallelLevel < normalCell->getTimestepLevel()) {
+                            normalCell->setTimestepLevel(parallelLevel);
+                            changes[0] = 1.0;
                         }
                     }
                 }
             }
-        } else {
-            // send to rank process
-            if (sendSyncIdsMap.count(rank) != 0) {
-                const auto& sendSyncIds = sendSyncIdsMap[rank];
-                for (auto sendSyncId : sendSyncIds) {
-                    auto cell = getCellById(sendSyncId);
-                    Parallel::send(SerializationUtils::serialize(cell->getValues()), rank, Parallel::COMMAND_SYNC_VALUES);
+            isChanged = Parallel::allReduce(changes, Parallel::Reduce::MAX)[0] > 0.0;
+        }
+    }
+
+    for (const auto& normalCell : _normalCells) {
+        maxLevel = std::max(maxLevel, normalCell->getTimestepLevel());
+    }
+    if (Parallel::isSingle() == false) {
+        maxLevel = static_cast<unsigned int>(Parallel::allReduce({static_cast<double>(maxLevel)}, Parallel::Reduce::MAX)[0]);
+    }
+    _substepsSize = 1u << maxLevel;
+
+    _levelNormalCells.resize(maxLevel + 1);
+    _levelBorderCells.resize(maxLevel + 1);
+    _levelFluxRegisters.resize(maxLevel + 1);
+    for (const auto& normalCell : _normalCells) {
+        _levelNormalCells[normalCell->getTimestepLevel()].push_back(normalCell);
+    }
+    for (const auto& borderCell : _borderCells) {
+        auto normalCell = dynamic_cast<NormalCell*>(borderCell->getConnections().front()->getSecond());
+        _levelBorderCells[normalCell->getTimestepLevel()].push_back(borderCell);
+    }
+
+    // one register for each face with coarser neighbor, shared by connections of both cells
+    for (const auto& normalCell : _normalCells) {
+        for (const auto& connection : normalCell->getConnections()) {
+            if (connection->getSecond()->getType() != BaseCell::Type::NORMAL) {
+                continue;
+            }
+            auto neighborCell = dynamic_cast<NormalCell*>(connection->getSecond());
+            if (neighborCell->getTimestepLevel() <= normalCell->getTimestepLevel()) {
+                continue;
+            }
+
+            // reverse connection of the same face
+            CellConnection* neighborConnection = nullptr;
+            double maxScalar = -std::numeric_limits<double>::max();
+            for (const auto& otherConnection : neighborCell->getConnections()) {
+                double scalar = otherConnection->getNormal12().scalar(connection->getNormal21());
+                if (otherConnection->getSecond() == normalCell && scalar > maxScalar) {
+                    neighborConnection = otherConnection.get();
+                    maxScalar = scalar;
                 }
             }
+            if (neighborConnection == nullptr) {
+                throw std::runtime_error("no reverse connection for multirate flux register");
+            }
+
+            std::shared_ptr<FluxRegister> fluxRegister(new FluxRegister(neighborCell, gases.size(), impulses.size()));
+            connection->setFluxRegister(fluxRegister);
+            neighborConnection->setFluxRegister(fluxRegister);
+            _fluxRegisters.push_back(fluxRegister);
+            _levelFluxRegisters[neighborCell->getTimestepLevel()].push_back(fluxRegister.get());
         }
     }
+
+    std::vector<double> levelSizes(maxLevel + 2, 0.0);
+    for (unsigned int level = 0; level <= maxLevel; level++) {
+        levelSizes[level] = _levelNormalCells[level].size();
+    }
+    levelSizes[maxLevel + 1] = _fluxRegisters.size();
+    if (Parallel::isSingle() == false) {
+        levelSizes = Parallel::allReduce(levelSizes, Parallel::Reduce::SUM);
+    }
+    if (Parallel::isMaster()) {
+        std::cout << "Multirate levels = " << maxLevel + 1 << "; cells by level =";
+        for (unsigned int level = 0; level <= maxLevel; level++) {
+            std::cout << " " << levelSizes[level];
+        }
+        std::cout << "; flux registers = " << levelSizes[maxLevel + 1] << std::endl;
+        double iterationTimestep = config->getTimestep() * _substepsSize;
+        config->getNormalizer()->restore(iterationTimestep, Normalizer::Type::TIME);
+        std::cout << "Iteration timestep (Normalized) = " << iterationTimestep << " seconds" << std::endl;
+    }
+}
+
+void Grid::beginSubstep(unsigned int substep) {
+    if (_substepsSize == 1) {
+        return;
+    }
+    _activeNormalCells.clear();
+    _activeBorderCells.clear();
+    for (unsigned int level = 0; level < _levelNormalCells.size() && substep % (1u << level) == 0; level++) {
+        for (const auto& fluxRegister : _levelFluxRegisters[level]) {
+            fluxRegister->apply();
+        }
+        _activeNormalCells.insert(_activeNormalCells.end(), _levelNormalCells[level].begin(), _levelNormalCells[level].end());
+        _activeBorderCells.insert(_activeBorderCells.end(), _levelBorderCells[level].begin(), _levelBorderCells[level].end());
+    }
+}
+
+void Grid::endSubsteps() {
+    for (const auto& fluxRegister : _fluxRegisters) {
+        fluxRegister->apply();
+    }
 }
 
 void Grid::addCell(BaseCell* cell) {
@@ -448,6 +851,60 @@ void Grid::addCell(BaseCell* cell) {
     }
 }
 
+std::vector<double> Grid::computeMasses() const {
+    auto gasesSize = Config::getInstance()->getGases().size();
+    std::vector<double> masses(gasesSize, 0.0);
+    for (const auto& cell : _normalCells) {
+        const auto& values = cell->getValues();
+        for (unsigned int gi = 0; gi < gasesSize; gi++) {
+            double sum = 0.0;
+            for (auto value : values[gi]) {
+                sum += value;
+            }
+            masses[gi] += sum * cell->getVolume();
+        }
+    }
+    if (Parallel::isSingle() == false) {
+        masses = Parallel::allReduce(masses, Parallel::Reduce::SUM);
+    }
+    return masses;
+}
+
+void Grid::scaleMasses(const std::vector<double>& newMasses) {
+    auto masses = computeMasses();
+    for (unsigned int gi = 0; gi < masses.size(); gi++) {
+        if (masses[gi] <= 0.0) {
+            continue;
+        }
+        double ratio = newMasses[gi] / masses[gi];
+        for (const auto& cell : _normalCells) {
+            for (auto& value : cell->getValues()[gi]) {
+                value *= ratio;
+            }
+        }
+    }
+}
+
+std::vector<double> Grid::getNormalValues() const {
+    std::vector<double> values;
+    for (const auto& cell : _normalCells) {
+        for (const auto& gasValues : cell->getValues()) {
+            values.insert(values.end(), gasValues.begin(), gasValues.end());
+        }
+    }
+    return values;
+}
+
+void Grid::setNormalValues(const std::vector<double>& values) {
+    auto value = values.begin();
+    for (const auto& cell : _normalCells) {
+        for (auto& gasValues : cell->getValues()) {
+            std::copy(value, value + gasValues.size(), gasValues.begin());
+            value += gasValues.size();
+        }
+    }
+}
+
 void Grid::normalizeVolume(Element* element, double& volume) {
     auto normalizer = Config::getInstance()->getNormalizer();
     if (element->is1D()) {
@@ -3,6 +3,7 @@
 
 #include "utilities/Types.h"
 #include "GridBuffer.h"
+#include "MaxwellianCache.h"
 
 #include <memory>
 #include <vector>
@@ -13,6 +14,13 @@ class NormalCell;
 class BorderCell;
 class ParallelCell;
 class CellConnection;
+class FluxRegister;
+class SweepSchedule;
+class SpectralCollisions;
+
+namespace ci {
+    struct node_calc;
+}
 class Mesh;
 class Element;
 
@@ -25,6 +33,36 @@ private:
     std::vector<BorderCell*> _borderCells;
     std::vector<ParallelCell*> _parallelCells;
     std::shared_ptr<GridBuffer> _buffer;
+    std::shared_ptr<MaxwellianCache> _maxwellianCache;     // of initial and border temperatures
+    std::shared_ptr<SweepSchedule> _sweepSchedule;  // cell orders of implicit scheme
+
+    // walls only, no inflow, outflow or decay
+    bool _isClosed;
+
+    // local time stepping doesn't conserve mass, so closed grid keeps initial mass of each gas
+    bool _isConservingMass;
+    std::vector<double> _masses;
+
+    // multirate time stepping: level l cells go with 2^l timesteps, iteration is 2^maxLevel timesteps
+    unsigned int _substepsSize;
+    std::vector<std::vector<NormalCell*>> _levelNormalCells;
+    std::vector<std::vector<BorderCell*>> _levelBorderCells;
+    std::vector<std::vector<FluxRegister*>> _levelFluxRegisters;  // by level of coarse cell
+    std::vector<std::shared_ptr<FluxRegister>> _fluxRegisters;
+    std::vector<NormalCell*> _activeNormalCells;    // cells which start new step at current substep
+    std::vector<BorderCell*> _activeBorderCells;
+
+    // collision nodes of each gases pair, kept while collisions are frozen
+    bool _isCollisionsFrozen;
+    std::map<std::pair<unsigned int, unsigned int>, std::shared_ptr<std::vector<ci::node_calc>>> _collisionNodes;
+
+    // deterministic collisions of gases pairs selected by spectral_pairs, lesser gas goes first in key
+    std::map<std::pair<unsigned int, unsigned int>, std::shared_ptr<SpectralCollisions>> _spectralCollisions;
+
+    // cell integrals computed, skipped near equilibrium and replaced by model in dense cells
+    unsigned long _collisionsSize;
+    unsigned long _skippedCollisionsSize;
+    unsigned long _modelCollisionsSize;
 
 public:
     explicit Grid(Mesh* mesh);
@@ -33,14 +71,50 @@ public:
 
     void computeTransfer();
 
-    void computeIntegral(unsigned int gi1, unsigned int gi2);
+    // collisions of gases pairs, beta decay and check of each active cell in one sweep over cells,
+    // check is off for trial values of newton and multigrid,
+    // collisions of gas with itself go by model in cells with knudsen below model_collision_knudsen
+    void computeCellOperators(bool isChecking);
+
+    // collision nodes of gases pair go to ci::nc, frozen ones are taken again
+    void prepareCollisions(unsigned int gi1, unsigned int gi2);
 
-    void computeBetaDecay(unsigned int gi0, unsigned int gi1, double lambda);
+    // cells closer to maxwellian than tolerance skip collisions until next update
+    void updateCollisionSkipping(double tolerance);
+
+    unsigned long getCollisionsSize() const {
+        return _collisionsSize;
+    }
+
+    unsigned long getSkippedCollisionsSize() const {
+        return _skippedCollisionsSize;
+    }
+
+    unsigned long getModelCollisionsSize() const {
+        return _modelCollisionsSize;
+    }
 
     void check();
 
+    // frozen collisions of each gases pair take nodes of first integral after freezing, so steps are repeatable
+    void setCollisionsFrozen(bool isCollisionsFrozen);
+
+    // solves (1 + timestep * scale * transfer) values = values by implicit sweeps, borders give nothing
+    void computeImplicitSweep(double timestepScale);
+
     void sync();
 
+    // one without multirate time stepping
+    unsigned int getSubstepsSize() const {
+        return _substepsSize;
+    }
+
+    // selects cells which start new step and gives them fluxes missed on previous one
+    void beginSubstep(unsigned int substep);
+
+    // must follow last substep, so all levels come to the same time
+    void endSubsteps();
+
     Mesh* getMesh() const {
         return _mesh;
     }
@@ -53,11 +127,59 @@ public:
         return _cells;
     }
 
+    const std::vector<NormalCell*>& getNormalCells() const {
+        return _normalCells;
+    }
+
+    const std::vector<BorderCell*>& getBorderCells() const {
+        return _borderCells;
+    }
+
+    const std::vector<ParallelCell*>& getParallelCells() const {
+        return _parallelCells;
+    }
+
+    GridBuffer* getBuffer() const {
+        return _buffer.get();
+    }
+
+    // null without implicit scheme and jfnk solver
+    const SweepSchedule* getSweepSchedule() const {
+        return _sweepSchedule.get();
+    }
+
+    MaxwellianCache* getMaxwellianCache() const {
+        return _maxwellianCache.get();
+    }
+
     void addCell(BaseCell* cell);
 
+    bool isClosed() const {
+        return _isClosed;
+    }
+
+    // sum over ranks of all gases masses, in values units
+    std::vector<double> computeMasses() const;
+
+    // collective, rescales values of each gas to given mass
+    void scaleMasses(const std::vector<double>& masses);
+
+    // values of all normal cells in one vector, gas and impulse go inside
+    std::vector<double> getNormalValues() const;
+
+    void setNormalValues(const std::vector<double>& values);
+
 private:
     void normalizeVolume(Element* element, double& volume);
 
+    void initMultirate(const std::vector<double>& scales);
+
+    // ranks of parallel cells to ids of own cells to send and of their cells to recv
+    void getSyncIds(std::map<int, std::vector<int>>& sendSyncIdsMap, std::map<int, std::vector<int>>& recvSyncIdsMap) const;
+
+    // multirate levels of parallel cells by their ids
+    std::map<int, unsigned int> syncLevels();
+
 };
 
 
@@ -0,0 +1,38 @@
+#include "MaxwellianCache.h"
+#include "core/Config.h"
+
+#include <cmath>
+
+const MaxwellianCache::Table& MaxwellianCache::get(unsigned int gi, double temperature) {
+    auto key = std::make_pair(gi, temperature);
+    auto item = _tables.find(key);
+    if (item != _tables.end()) {
+        return item->second;
+    }
+
+    auto& table = _tables[key];
+    compute(gi, temperature, table);
+    return table;
+}
+
+const MaxwellianCache::Table& MaxwellianCache::find(unsigned int gi, double temperature, Table& table) const {
+    auto item = _tables.find(std::make_pair(gi, temperature));
+    if (item != _tables.end()) {
+        return item->second;
+    }
+    compute(gi, temperature, table);
+    return table;
+}
+
+void MaxwellianCache::compute(unsigned int gi, double temperature, Table& table) {
+    auto config = Config::getInstance();
+    double mass = config->getGases()[gi].getMass();
+    const auto& impulses = config->getImpulseSphere()->getImpulses();
+
+    table.values.resize(impulses.size());
+    table.sum = 0.0;
+    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+        table.values[ii] = std::exp(-impulses[ii].moduleSquare() / mass / 2 / temperature);
+        table.sum += table.values[ii];
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef RGS_MAXWELLIANCACHE_H
+#define RGS_MAXWELLIANCACHE_H
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// Exponents exp(-p^2 / 2mT) over impulse sphere, one table for each gas and shared temperature of grid.
+// Cells of one physical group have the same temperature, so they share the same table instead of
+// own copy. Tables are never removed, so references to them stay valid while cache lives.
+// Temperatures of gradients differ in each cell, their tables are computed once and not kept.
+class MaxwellianCache {
+public:
+    struct Table {
+        std::vector<double> values;     // of each impulse
+        double sum;                     // of values over whole sphere
+    };
+
+private:
+    static void compute(unsigned int gi, double temperature, Table& table);
+
+    std::map<std::pair<unsigned int, double>, Table> _tables;
+
+public:
+    // table is computed on first request and kept
+    const Table& get(unsigned int gi, double temperature);
+
+    // kept table if any, otherwise it's computed into given one
+    const Table& find(unsigned int gi, double temperature, Table& table) const;
+
+    const std::map<std::pair<unsigned int, double>, Table>& getTables() const {
+        return _tables;
+    }
+
+};
+
+#endif //RGS_MAXWELLIANCACHE_H
@@ -1,8 +1,27 @@
 #include "NormalCell.h"
 #include "CellConnection.h"
+#include "FluxRegister.h"
 #include "integral/ci.hpp"
 #include "integral/ci_impl.hpp"
 
+#include <limits>
+
+namespace {
+
+    // buffers reused by all cells of thread, so per cell operators don't allocate
+    struct Scratch {
+        std::vector<double> densities;
+        std::vector<double> temperatures;
+        std::vector<Vector3d> velocities;
+        std::vector<double> maxwellianFactors;
+        std::vector<double> target;             // of model collisions
+        MaxwellianCache::Table maxwellian;      // initial one of temperature which isn't kept in cache
+    };
+
+    thread_local Scratch scratch;
+
+}
+
 void NormalCell::init() {
     auto config = Config::getInstance();
     const auto& gases = config->getGases();
@@ -16,15 +35,12 @@ void NormalCell::init() {
         _values[gi].resize(impulses.size(), 0.0);
         _newValues[gi].resize(impulses.size(), 0.0);
 
-        double coeff = 0.0;
-        for (const auto& impulse : impulses) {
-            coeff += std::exp(-impulse.moduleSquare() / gases[gi].getMass() / 2 / _params.getTemp(gi));
-        }
-        coeff = 1.0 / coeff;
+        const auto& maxwellian = _maxwellianCache->find(gi, _params.getTemp(gi), scratch.maxwellian);
+        double coeff = 1.0 / maxwellian.sum;
         coeff *= _params.getPressure(gi) / _params.getTemp(gi) / config->getImpulseSphere()->getDeltaImpulseQube();
 
         for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-            _values[gi][ii] = coeff * std::exp(-impulses[ii].moduleSquare() / gases[gi].getMass() / 2 / _params.getTemp(gi));
+            _values[gi][ii] = coeff * maxwellian.values[ii];
         }
     }
 }
@@ -33,7 +49,7 @@ void NormalCell::computeTransfer() {
     auto config = Config::getInstance();
     const auto& gases = config->getGases();
     const auto& impulses = config->getImpulseSphere()->getImpulses();
-    auto timestep = config->getTimestep() / 2;
+    auto timestep = config->getTimestep() * _timestepScale / 2;
 
     for (unsigned int gi = 0; gi < gases.size(); gi++) {
         double y = timestep / _volume / gases[gi].getMass();
@@ -55,10 +71,172 @@ void NormalCell::computeTransfer() {
             _newValues[gi][ii] = _values[gi][ii] + sum * y;
         }
     }
+
+    // mass taken through faces with cells of other multirate level, same values as above
+    for (auto& connection : _connections) {
+        auto fluxRegister = connection->getFluxRegister();
+        if (fluxRegister == nullptr) {
+            continue;
+        }
+        for (unsigned int gi = 0; gi < gases.size(); gi++) {
+            double y = timestep / gases[gi].getMass();
+            for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+                double projection = connection->getNormal21().scalar(impulses[ii]);
+                if (projection != 0) {
+                    double value;
+                    if (projection < 0) {
+                        value = connection->getFirst()->getValues()[gi][ii];
+                    } else {
+                        value = connection->getSecond()->getValues()[gi][ii];
+                    }
+                    fluxRegister->add(gi, ii, -value * projection * connection->getSquare() * y);
+                }
+            }
+        }
+    }
 }
 
 void NormalCell::computeIntegral(int gi0, int gi1) {
-    ci::iter(_values[gi0], _values[gi1]);
+    ci::iter(_values[gi0], _values[gi1], _timestepScale);
+}
+
+void NormalCell::computeIntegral(const std::vector<ci::node_calc>& nodes, int gi0, int gi1) {
+    ci::iter(nodes, _values[gi0], _values[gi1], _timestepScale);
+}
+
+void NormalCell::computeModelIntegral(int gi) {
+    auto config = Config::getInstance();
+    const auto& gases = config->getGases();
+    auto impulseSphere = config->getImpulseSphere();
+    const auto& impulses = impulseSphere->getImpulses();
+    auto& values = _values[gi];
+    double mass = gases[gi].getMass();
+
+    double moments[ImpulseSphere::MOMENTS_SIZE];
+    impulseSphere->computeMoments(values, moments);
+    double density = moments[0];
+    if (density <= 0.0) {
+        return;
+    }
+    double temperature = computeTemperature(moments, mass);
+    if (temperature <= 0.0) {
+        return;
+    }
+    Vector3d velocity = Vector3d(moments[1], moments[2], moments[3]) / (density * mass);
+    double thermalSpeed2 = temperature / mass;
+
+    // heat flow is central moment, so it takes own pass, plain doubles go in loops over impulses
+    const auto& impulsesX = impulseSphere->getImpulsesX();
+    const auto& impulsesY = impulseSphere->getImpulsesY();
+    const auto& impulsesZ = impulseSphere->getImpulsesZ();
+    double heatFlow[3] = {};
+    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+        double speed[3] = {impulsesX[ii] / mass - velocity.x(), impulsesY[ii] / mass - velocity.y(), impulsesZ[ii] / mass - velocity.z()};
+        double speed2 = speed[0] * speed[0] + speed[1] * speed[1] + speed[2] * speed[2];
+        for (unsigned int k = 0; k < 3; k++) {
+            heatFlow[k] += speed[k] * speed2 * values[ii];
+        }
+    }
+    for (unsigned int k = 0; k < 3; k++) {
+        heatFlow[k] *= mass / 2 * impulseSphere->getDeltaImpulseQube();
+    }
+
+    // maxwellian with heat flow correction of prandtl number 2/3, negative tails are cut
+    const double prandtl = 2.0 / 3;
+    double heatFactor = (1 - prandtl) / (5 * density * temperature * thermalSpeed2);
+    auto& maxwellianFactors = scratch.maxwellianFactors;
+    auto& target = scratch.target;
+    impulseSphere->computeMaxwellianFactors(mass, velocity, temperature, maxwellianFactors);
+    target.resize(impulses.size());
+    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+        double speed[3] = {impulsesX[ii] / mass - velocity.x(), impulsesY[ii] / mass - velocity.y(), impulsesZ[ii] / mass - velocity.z()};
+        double speed2 = (speed[0] * speed[0] + speed[1] * speed[1] + speed[2] * speed[2]) / thermalSpeed2;
+        double heatProjection = speed[0] * heatFlow[0] + speed[1] * heatFlow[1] + speed[2] * heatFlow[2];
+        target[ii] = std::max(impulseSphere->getMaxwellian(maxwellianFactors, ii) * (1 + heatFactor * heatProjection * (speed2 - 5)), 0.0);
+    }
+
+    // target times polynomial of impulse keeps density, momentum and energy of discrete values exactly
+    double maxImpulse = impulseSphere->getMaxImpulse();
+    double matrix[5][6] = {};
+    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+        const auto& impulse = impulses[ii];
+        double basis[5] = {1.0, impulse.x() / maxImpulse, impulse.y() / maxImpulse, impulse.z() / maxImpulse, 0.0};
+        basis[4] = basis[1] * basis[1] + basis[2] * basis[2] + basis[3] * basis[3];
+        for (unsigned int k = 0; k < 5; k++) {
+            for (unsigned int j = k; j < 5; j++) {
+                matrix[k][j] += basis[k] * basis[j] * target[ii];
+            }
+            matrix[k][5] += basis[k] * values[ii];
+        }
+    }
+    for (unsigned int k = 0; k < 5; k++) {
+        for (unsigned int j = 0; j < k; j++) {
+            matrix[k][j] = matrix[j][k];
+        }
+    }
+    for (unsigned int k = 0; k < 5; k++) {
+        unsigned int pivot = k;
+        for (unsigned int j = k + 1; j < 5; j++) {
+            if (std::abs(matrix[j][k]) > std::abs(matrix[pivot][k])) {
+                pivot = j;
+            }
+        }
+        for (unsigned int j = 0; j < 6; j++) {
+            std::swap(matrix[k][j], matrix[pivot][j]);
+        }
+        for (unsigned int j = k + 1; j < 5; j++) {
+            double factor = matrix[j][k] / matrix[k][k];
+            for (unsigned int l = k; l < 6; l++) {
+                matrix[j][l] -= factor * matrix[k][l];
+            }
+        }
+    }
+    double coefficients[5];
+    for (int k = 4; k >= 0; k--) {
+        double value = matrix[k][5];
+        for (unsigned int j = k + 1; j < 5; j++) {
+            value -= matrix[k][j] * coefficients[j];
+        }
+        coefficients[k] = value / matrix[k][k];
+    }
+
+    // hard spheres frequency p / mu in units of lambda, relaxation is exact in time, so it stays stable at any frequency
+    double radius = gases[gi].getRadius();
+    double frequency = 16 / (5 * std::sqrt(2 * M_PI)) * density * radius * radius * std::sqrt(thermalSpeed2);
+    double decay = std::exp(-frequency * config->getTimestep() * _timestepScale);
+    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+        const auto& impulse = impulses[ii];
+        double x = impulse.x() / maxImpulse, y = impulse.y() / maxImpulse, z = impulse.z() / maxImpulse;
+        double factor = coefficients[0] + coefficients[1] * x + coefficients[2] * y + coefficients[3] * z +
+                        coefficients[4] * (x * x + y * y + z * z);
+        double value = target[ii] * factor;
+        values[ii] = value + (values[ii] - value) * decay;
+    }
+}
+
+double NormalCell::computeKnudsen(int gi) {
+    auto config = Config::getInstance();
+    const auto& gases = config->getGases();
+    auto impulseSphere = config->getImpulseSphere();
+    double moments[ImpulseSphere::MOMENTS_SIZE];
+
+    // hard spheres of all gases, density and radius in units of lambda are its inverse for single gas
+    double inversePath = 0.0;
+    for (unsigned int gj = 0; gj < gases.size(); gj++) {
+        double radius = (gases[gi].getRadius() + gases[gj].getRadius()) / 2;
+        impulseSphere->computeMoments(_values[gj], moments);
+        inversePath += moments[0] * radius * radius * std::sqrt((1 + gases[gi].getMass() / gases[gj].getMass()) / 2);
+    }
+    if (inversePath <= 0.0) {
+        return std::numeric_limits<double>::max();
+    }
+
+    // size of cube with the same volume to faces square
+    double square = 0.0;
+    for (const auto& connection : _connections) {
+        square += connection->getSquare();
+    }
+    return 1.0 / inversePath / (6 * _volume / square);
 }
 
 void NormalCell::computeBetaDecay(int gi0, int gi1, double lambda) {
@@ -66,7 +244,7 @@ void NormalCell::computeBetaDecay(int gi0, int gi1, double lambda) {
     const auto& impulses = config->getImpulseSphere()->getImpulses();
 
     for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        double impact = _values[gi0][ii] * lambda * config->getTimestep();
+        double impact = _values[gi0][ii] * lambda * config->getTimestep() * _timestepScale;
         _values[gi0][ii] -= impact;
         _values[gi1][ii] += impact;
     }
@@ -86,39 +264,37 @@ void NormalCell::swapValues() {
 }
 
 void NormalCell::computeImplicitTransfer(int ii) {
-    if (_isImplicitTransferComputed == false) {
-        auto config = Config::getInstance();
-        const auto& gases = config->getGases();
-        const auto& impulses = config->getImpulseSphere()->getImpulses();
-        auto timestep = config->getTimestep() / 2;
+    computeImplicitTransfer(ii, 1.0);
+}
 
-        for (unsigned int gi = 0; gi < gases.size(); gi++) {
-            double y = timestep / _volume / gases[gi].getMass();
+void NormalCell::computeImplicitTransfer(int ii, double timestepScale) {
+    auto config = Config::getInstance();
+    const auto& gases = config->getGases();
+    const auto& impulses = config->getImpulseSphere()->getImpulses();
+    auto timestep = config->getTimestep() * _timestepScale * timestepScale / 2;
 
-            double sumUp = 0.0, sumDown = 0.0;
-            for (auto& connection : _connections) {
-                double projection = connection->getNormal12().scalar(impulses[ii]);
-                if (projection != 0) {
-                    if (projection < 0) {
+    for (unsigned int gi = 0; gi < gases.size(); gi++) {
+        double y = timestep / _volume / gases[gi].getMass();
 
-                        // need to find value first, go recursive here
-                        connection->getSecond()->computeImplicitTransfer(ii);
-                        sumUp += connection->getSecond()->getValues()[gi][ii] * projection * connection->getSquare();
-                    } else {
-                        sumDown += projection * connection->getSquare();
-                    }
+        double sumUp = 0.0, sumDown = 0.0;
+        for (auto& connection : _connections) {
+            double projection = connection->getNormal12().scalar(impulses[ii]);
+            if (projection != 0) {
+                if (projection < 0) {
+                    sumUp += connection->getSecond()->getValues()[gi][ii] * projection * connection->getSquare();
+                } else {
+                    sumDown += projection * connection->getSquare();
                 }
             }
-            _values[gi][ii] = (_values[gi][ii] - sumUp * y) / (1 + sumDown * y);
         }
-
-        _isImplicitTransferComputed = true;
+        _values[gi][ii] = (_values[gi][ii] - sumUp * y) / (1 + sumDown * y);
     }
 }
 
 CellResults* NormalCell::getResults() {
     auto config = Config::getInstance();
     const auto& gases = config->getGases();
+    auto impulseSphere = config->getImpulseSphere();
 
     // lazy initialization
     if (_results == nullptr) {
@@ -128,18 +304,22 @@ CellResults* NormalCell::getResults() {
     // clear current values
     _results->reset();
 
-    // fill results
+    // fill results, all go from raw moments of one pass
+    double moments[ImpulseSphere::MOMENTS_SIZE];
     for (unsigned int gi = 0; gi < gases.size(); gi++) {
-        double density = compute_density(gi);
-        Vector3d flow = compute_stream(gi);
+        double mass = gases[gi].getMass();
+        impulseSphere->computeMoments(_values[gi], moments);
+
+        double density = moments[0];
+        Vector3d flow(moments[1] / mass, moments[2] / mass, moments[3] / mass);
 
         double temp = 0.0, pressure = 0.0;
         Vector3d heatFlow;
 
         if (density > 0.0) {
-            temp = compute_temperature(gi, density, flow);
-            pressure = compute_pressure(gi, density, temp);
-            heatFlow = compute_heatstream(gi);
+            temp = computeTemperature(moments, mass);
+            pressure = density * temp;
+            heatFlow = Vector3d(moments[5], moments[6], moments[7]) / (2 * mass * mass);
         }
         _results->set(gi, pressure, density, temp, flow, heatFlow);
     }
@@ -148,65 +328,81 @@ CellResults* NormalCell::getResults() {
     return _results.get();
 }
 
-double NormalCell::compute_density(int gi) {
+void NormalCell::computeMoments(unsigned int gi, double& density, Vector3d& velocity, double& temperature) {
     auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    auto impulseSphere = config->getImpulseSphere();
-    const auto& impulses = config->getImpulseSphere()->getImpulses();
-
-    double density = 0.0;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        density += _values[gi][ii];
+    double mass = config->getGases()[gi].getMass();
+
+    double moments[ImpulseSphere::MOMENTS_SIZE];
+    config->getImpulseSphere()->computeMoments(_values[gi], moments);
+    density = moments[0];
+    velocity = Vector3d();
+    temperature = 0.0;
+    if (density > 0.0) {
+        temperature = computeTemperature(moments, mass);
+        velocity = Vector3d(moments[1], moments[2], moments[3]) / (density * mass);
     }
-    density *= impulseSphere->getDeltaImpulseQube();
-    return density;
 }
 
-double NormalCell::compute_temperature(int gi, double density, const Vector3d& stream) {
+double NormalCell::computeNonEquilibrium() {
     auto config = Config::getInstance();
     const auto& gases = config->getGases();
     auto impulseSphere = config->getImpulseSphere();
-    const auto& impulses = impulseSphere->getImpulses();
-
-    Vector3d averageSpeed = stream / density;
-
+    unsigned int impulsesSize = impulseSphere->getImpulses().size();
+
+    // mixture velocity is mass weighted, diffusion of gases goes into mixture temperature
+    auto& densities = scratch.densities;
+    auto& temperatures = scratch.temperatures;
+    auto& velocities = scratch.velocities;
+    auto& maxwellianFactors = scratch.maxwellianFactors;
+    densities.resize(gases.size());
+    temperatures.resize(gases.size());
+    velocities.resize(gases.size());
+    double density = 0.0, massDensity = 0.0;
+    Vector3d momentum;
+    for (unsigned int gi = 0; gi < gases.size(); gi++) {
+        computeMoments(gi, densities[gi], velocities[gi], temperatures[gi]);
+        density += densities[gi];
+        massDensity += densities[gi] * gases[gi].getMass();
+        momentum += velocities[gi] * densities[gi] * gases[gi].getMass();
+    }
+    if (density <= 0.0) {
+        return 0.0;
+    }
+    Vector3d velocity = momentum / massDensity;
     double temperature = 0.0;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        Vector3d vTemp = impulses[ii] / gases[gi].getMass() - averageSpeed;
-        temperature += vTemp.moduleSquare() * _values[gi][ii];
+    for (unsigned int gi = 0; gi < gases.size(); gi++) {
+        Vector3d diffusion = velocities[gi] - velocity;
+        temperature += densities[gi] * (temperatures[gi] + gases[gi].getMass() * diffusion.moduleSquare() / 3);
     }
-    temperature *= gases[gi].getMass() * impulseSphere->getDeltaImpulseQube() / density / 3;
-    return temperature;
-}
+    temperature /= density;
 
-double NormalCell::compute_pressure(int gi, double density, double temperature) {
-    return density * temperature;
-}
-
-Vector3d NormalCell::compute_stream(int gi) {
-    auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    auto impulseSphere = config->getImpulseSphere();
-    const auto& impulses = impulseSphere->getImpulses();
+    double nonEquilibrium = 0.0;
+    for (unsigned int gi = 0; gi < gases.size(); gi++) {
+        if (densities[gi] <= 0.0) {
+            continue;
+        }
 
-    Vector3d stream;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        stream += impulses[ii] * _values[gi][ii];
+        // discrete maxwellian is normalized to the same sum of values
+        const auto& values = _values[gi];
+        impulseSphere->computeMaxwellianFactors(gases[gi].getMass(), velocity, temperature, maxwellianFactors);
+        double sum = densities[gi] / impulseSphere->getDeltaImpulseQube();
+        double maxwellianSum = 0.0;
+        for (unsigned int ii = 0; ii < impulsesSize; ii++) {
+            maxwellianSum += impulseSphere->getMaxwellian(maxwellianFactors, ii);
+        }
+        double scale = sum / maxwellianSum;
+        double distance = 0.0;
+        for (unsigned int ii = 0; ii < impulsesSize; ii++) {
+            distance += std::abs(values[ii] - impulseSphere->getMaxwellian(maxwellianFactors, ii) * scale);
+        }
+        nonEquilibrium = std::max(nonEquilibrium, distance / sum);
     }
-    stream *= impulseSphere->getDeltaImpulseQube() / gases[gi].getMass();
-    return stream;
+    return nonEquilibrium;
 }
 
-Vector3d NormalCell::compute_heatstream(int gi) {
-    auto config = Config::getInstance();
-    const auto& gases = config->getGases();
-    auto impulseSphere = config->getImpulseSphere();
-    const auto& impulses = impulseSphere->getImpulses();
+double NormalCell::computeTemperature(const double* moments, double mass) {
 
-    Vector3d heatstream;
-    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
-        heatstream += impulses[ii] * impulses[ii].moduleSquare() * _values[gi][ii];
-    }
-    heatstream *= impulseSphere->getDeltaImpulseQube() / 2 / std::pow(gases[gi].getMass(), 2);
-    return heatstream;
+    // mean of square of own speed is mean of square of speed minus square of mean speed
+    double streamSquare = moments[1] * moments[1] + moments[2] * moments[2] + moments[3] * moments[3];
+    return std::max(moments[4] - streamSquare / moments[0], 0.0) / (3 * mass * moments[0]);
 }
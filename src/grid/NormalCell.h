@@ -4,47 +4,104 @@
 #include "BaseCell.h"
 #include "CellParameters.h"
 #include "CellResults.h"
+#include "MaxwellianCache.h"
+
+namespace ci {
+    struct node_calc;
+}
 
 class NormalCell : public BaseCell {
 private:
     double _volume;
+    double _timestepScale;  // own timestep is global one multiplied by scale
+    unsigned int _timestepLevel;    // multirate level, scale is 2^level
     CellParameters _params;
+    MaxwellianCache* _maxwellianCache;  // initial maxwellians of shared temperatures are taken from it
     std::vector<std::vector<double>> _newValues;
     std::shared_ptr<CellResults> _results;
+    bool _isCollisionSkipped;       // values are close to maxwellian, collisions don't change them
 
 public:
-    NormalCell(int id, double volume) : BaseCell(Type::NORMAL, id) {
+    NormalCell(int id, double volume, MaxwellianCache* maxwellianCache) : BaseCell(Type::NORMAL, id), _maxwellianCache(maxwellianCache) {
         _volume = volume;
+        _timestepScale = 1.0;
+        _timestepLevel = 0;
+        _isCollisionSkipped = false;
     }
 
     double getVolume() const {
         return _volume;
     }
 
+    double getTimestepScale() const {
+        return _timestepScale;
+    }
+
+    void setTimestepScale(double timestepScale) {
+        _timestepScale = timestepScale;
+    }
+
+    unsigned int getTimestepLevel() const {
+        return _timestepLevel;
+    }
+
+    void setTimestepLevel(unsigned int timestepLevel) {
+        _timestepLevel = timestepLevel;
+        _timestepScale = 1 << timestepLevel;
+    }
+
+    bool isCollisionSkipped() const {
+        return _isCollisionSkipped;
+    }
+
+    void setCollisionSkipped(bool isCollisionSkipped) {
+        _isCollisionSkipped = isCollisionSkipped;
+    }
+
     CellParameters& getParams() {
         return _params;
     }
 
+    const std::vector<std::vector<double>>& getNewValues() const {
+        return _newValues;
+    }
+
     void init() override;
 
     void computeTransfer() override;
 
     void computeIntegral(int gi0, int gi1) override;
 
+    // collision nodes of gases pair are given, so nodes of few pairs can go in one sweep
+    void computeIntegral(const std::vector<ci::node_calc>& nodes, int gi0, int gi1);
+
+    // shakhov model of collisions of gas with itself, cheap replacement of integral in dense cells
+    void computeModelIntegral(int gi);
+
+    // mean free path of gas molecules to cell size
+    double computeKnudsen(int gi);
+
     void computeBetaDecay(int gi0, int gi1, double lambda) override;
 
     void swapValues();
 
+    // upwind neighbors must be computed before, see SweepSchedule
     void computeImplicitTransfer(int ii) override;
 
+    void computeImplicitTransfer(int ii, double timestepScale);
+
     CellResults* getResults();
 
+    // density, velocity and temperature only, cheaper than results
+    void computeMoments(unsigned int gi, double& density, Vector3d& velocity, double& temperature);
+
+    // max over gases of L1 distance of values to maxwellian with velocity and temperature of mixture,
+    // relative to density, zero at equilibrium up to impulse sphere discretization
+    double computeNonEquilibrium();
+
 private:
-    double compute_density(int gi);
-    double compute_temperature(int gi, double density, const Vector3d& stream);
-    double compute_pressure(int gi, double density, double temperature);
-    Vector3d compute_stream(int gi);
-    Vector3d compute_heatstream(int gi);
+    // temperature by raw moments of impulse sphere, density must be positive
+    static double computeTemperature(const double* moments, double mass);
 
 };
 
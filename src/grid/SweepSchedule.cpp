@@ -0,0 +1,411 @@
+#include "SweepSchedule.h"
+#include "NormalCell.h"
+#include "ParallelCell.h"
+#include "CellConnection.h"
+#include "core/Config.h"
+#include "parameters/ImpulseSphere.h"
+#include "utilities/Parallel.h"
+#include "utilities/SerializationUtils.h"
+#include "utilities/Tracer.h"
+
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+
+namespace {
+
+    // connection of normal cell with other normal cell on the same rank, or with parallel cell of neighbor rank
+    struct Face {
+        unsigned int cell;
+        unsigned int neighbor;
+        Vector3d normal12;
+    };
+
+    // cell takes value of neighbor for impulse going into cell
+    bool isUpwind(const Face& face, const Vector3d& impulse) {
+        return face.normal12.scalar(impulse) < 0;
+    }
+
+    std::size_t getSignsHash(const std::vector<Face>& faces, const Vector3d& impulse) {
+        std::size_t hash = 14695981039346656037ULL;
+        for (const auto& face : faces) {
+            hash = (hash ^ (isUpwind(face, impulse) ? 1 : 0)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    bool isSameSigns(const std::vector<Face>& faces, const Vector3d& impulse1, const Vector3d& impulse2) {
+        for (const auto& face : faces) {
+            if (isUpwind(face, impulse1) != isUpwind(face, impulse2)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Kahn's algorithm, when upwind cycle is left the cell with least unresolved neighbors goes first
+    std::vector<unsigned int> getOrder(const std::vector<Face>& faces, unsigned int cellsSize, const Vector3d& impulse, unsigned int& laggedSize) {
+        std::vector<unsigned int> inDegrees(cellsSize, 0);
+        std::vector<std::vector<unsigned int>> downwinds(cellsSize);
+        for (const auto& face : faces) {
+            if (isUpwind(face, impulse)) {
+                inDegrees[face.cell]++;
+                downwinds[face.neighbor].push_back(face.cell);
+            }
+        }
+
+        std::deque<unsigned int> queue;
+        for (unsigned int ci = 0; ci < cellsSize; ci++) {
+            if (inDegrees[ci] == 0) {
+                queue.push_back(ci);
+            }
+        }
+
+        std::vector<unsigned int> order;
+        std::vector<bool> isOrdered(cellsSize, false);
+        order.reserve(cellsSize);
+        while (order.size() < cellsSize) {
+            if (queue.empty()) {
+                unsigned int lagged = cellsSize;
+                for (unsigned int ci = 0; ci < cellsSize; ci++) {
+                    if (isOrdered[ci] == false && (lagged == cellsSize || inDegrees[ci] < inDegrees[lagged])) {
+                        lagged = ci;
+                    }
+                }
+                inDegrees[lagged] = 0;
+                queue.push_back(lagged);
+                laggedSize++;
+            }
+
+            auto ci = queue.front();
+            queue.pop_front();
+            isOrdered[ci] = true;
+            order.push_back(ci);
+            for (auto downwind : downwinds[ci]) {
+                if (isOrdered[downwind] == false && inDegrees[downwind] > 0 && --inDegrees[downwind] == 0) {
+                    queue.push_back(downwind);
+                }
+            }
+        }
+        return order;
+    }
+
+}
+
+SweepSchedule::SweepSchedule(const std::vector<NormalCell*>& normalCells,
+                             const std::map<int, std::vector<BaseCell*>>& sendCells,
+                             const std::map<int, std::vector<BaseCell*>>& recvCells,
+                             unsigned int threadsSize)
+: _cells(normalCells), _laggedSize(0), _laggedRanksSize(0), _sendCells(sendCells), _recvCells(recvCells),
+  _runId(0), _activeSize(0), _isStopping(false), _next(0), _end(0), _timestepScale(1.0) {
+    const auto& impulses = Config::getInstance()->getImpulseSphere()->getImpulses();
+
+    _threadsSize = threadsSize != 0 ? threadsSize : std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::unordered_map<BaseCell*, unsigned int> indexes;
+    for (unsigned int ci = 0; ci < normalCells.size(); ci++) {
+        indexes[normalCells[ci]] = ci;
+    }
+    std::vector<Face> faces, parallelFaces;
+    for (unsigned int ci = 0; ci < normalCells.size(); ci++) {
+        for (const auto& connection : normalCells[ci]->getConnections()) {
+            auto index = indexes.find(connection->getSecond());
+            if (index != indexes.end()) {
+                faces.push_back({ci, index->second, connection->getNormal12()});
+            } else if (connection->getSecond()->getType() == BaseCell::Type::PARALLEL) {
+                auto rank = dynamic_cast<ParallelCell*>(connection->getSecond())->getSyncProcessId();
+                parallelFaces.push_back({ci, static_cast<unsigned int>(rank), connection->getNormal12()});
+            }
+        }
+    }
+
+    // group impulses by signs, hash only picks candidates
+    std::unordered_map<std::size_t, std::vector<unsigned int>> groupsByHash;
+    std::vector<unsigned int> impulseGroups(impulses.size());
+    for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+        auto hash = getSignsHash(faces, impulses[ii]) ^ getSignsHash(parallelFaces, impulses[ii]);
+        auto& candidates = groupsByHash[hash];
+        bool isAdded = false;
+        for (auto group : candidates) {
+            const auto& first = impulses[_groups[group].impulses.front()];
+            if (isSameSigns(faces, first, impulses[ii]) && isSameSigns(parallelFaces, first, impulses[ii])) {
+                _groups[group].impulses.push_back(ii);
+                impulseGroups[ii] = group;
+                isAdded = true;
+                break;
+            }
+        }
+        if (isAdded == false) {
+            candidates.push_back(_groups.size());
+            impulseGroups[ii] = _groups.size();
+            _groups.emplace_back();
+            _groups.back().impulses.push_back(ii);
+        }
+    }
+
+    std::vector<std::vector<bool>> groupRecvRanks(_groups.size(), std::vector<bool>(Parallel::getSize(), false));
+    std::map<std::vector<unsigned int>, unsigned int> orders;
+    for (unsigned int group = 0; group < _groups.size(); group++) {
+        const auto& impulse = impulses[_groups[group].impulses.front()];
+        auto order = orders.insert({getOrder(faces, normalCells.size(), impulse, _laggedSize), orders.size()});
+        if (order.second) {
+            _orders.push_back(order.first->first);
+        }
+        _groups[group].order = order.first->second;
+        for (const auto& face : parallelFaces) {
+            if (isUpwind(face, impulse)) {
+                groupRecvRanks[group][face.neighbor] = true;
+            }
+        }
+    }
+
+    if (Parallel::isSingle() == false) {
+        initRanks(impulseGroups, groupRecvRanks);
+    }
+
+    // neighbor impulses of one thread are close in memory
+    for (unsigned int group = 0; group < _groups.size(); group++) {
+        _groupItems.push_back(_items.size());
+        unsigned int impulsesSize = _groups[group].impulses.size();
+        unsigned int itemsSize = std::min(_threadsSize, impulsesSize);
+        for (unsigned int ti = 0; ti < itemsSize; ti++) {
+            _items.push_back({group, impulsesSize * ti / itemsSize, impulsesSize * (ti + 1) / itemsSize});
+        }
+    }
+    _groupItems.push_back(_items.size());
+}
+
+SweepSchedule::~SweepSchedule() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _runCondition.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void SweepSchedule::initRanks(const std::vector<unsigned int>& impulseGroups,
+                              const std::vector<std::vector<bool>>& groupRecvRanks) {
+    unsigned int ranksSize = Parallel::getSize();
+    unsigned int impulsesSize = impulseGroups.size();
+    int rank = Parallel::getRank();
+
+    // own groups of all ranks for each impulse
+    std::vector<double> allGroups(ranksSize * impulsesSize, 0.0);
+    for (unsigned int ii = 0; ii < impulsesSize; ii++) {
+        allGroups[rank * impulsesSize + ii] = impulseGroups[ii];
+    }
+    allGroups = Parallel::allReduce(allGroups, Parallel::Reduce::SUM);
+
+    // impulses go together only when they do on each rank, keys are the same everywhere, so is numbering
+    std::map<std::vector<unsigned int>, unsigned int> keys;
+    std::vector<Group> groups;
+    std::vector<unsigned int> ownGroups;
+    for (unsigned int ii = 0; ii < impulsesSize; ii++) {
+        std::vector<unsigned int> key(ranksSize);
+        for (unsigned int ri = 0; ri < ranksSize; ri++) {
+            key[ri] = static_cast<unsigned int>(allGroups[ri * impulsesSize + ii]);
+        }
+        auto found = keys.find(key);
+        if (found == keys.end()) {
+            found = keys.insert({key, groups.size()}).first;
+            groups.emplace_back();
+            groups.back().order = _groups[impulseGroups[ii]].order;
+            ownGroups.push_back(impulseGroups[ii]);
+        }
+        groups[found->second].impulses.push_back(ii);
+    }
+
+    // edges from upwind sender to receiver for each group
+    std::vector<double> edges(groups.size() * ranksSize * ranksSize, 0.0);
+    for (unsigned int group = 0; group < groups.size(); group++) {
+        for (unsigned int sender = 0; sender < ranksSize; sender++) {
+            if (groupRecvRanks[ownGroups[group]][sender]) {
+                edges[(group * ranksSize + rank) * ranksSize + sender] = 1.0;
+            }
+        }
+    }
+    edges = Parallel::allReduce(edges, Parallel::Reduce::SUM);
+
+    // Kahn's algorithm over ranks, edges of rank cycles are lagged
+    for (unsigned int group = 0; group < groups.size(); group++) {
+        auto edge = [&](unsigned int receiver, unsigned int sender) -> double& {
+            return edges[(group * ranksSize + receiver) * ranksSize + sender];
+        };
+
+        std::vector<unsigned int> inDegrees(ranksSize, 0);
+        for (unsigned int receiver = 0; receiver < ranksSize; receiver++) {
+            for (unsigned int sender = 0; sender < ranksSize; sender++) {
+                inDegrees[receiver] += edge(receiver, sender) > 0.0 ? 1 : 0;
+            }
+        }
+
+        std::vector<bool> isOrdered(ranksSize, false);
+        for (unsigned int step = 0; step < ranksSize; step++) {
+            unsigned int next = ranksSize;
+            for (unsigned int ri = 0; ri < ranksSize && next == ranksSize; ri++) {
+                if (isOrdered[ri] == false && inDegrees[ri] == 0) {
+                    next = ri;
+                }
+            }
+            if (next == ranksSize) {
+                for (unsigned int ri = 0; ri < ranksSize && next == ranksSize; ri++) {
+                    if (isOrdered[ri] == false) {
+                        next = ri;
+                    }
+                }
+                for (unsigned int sender = 0; sender < ranksSize; sender++) {
+                    if (isOrdered[sender] == false && edge(next, sender) > 0.0) {
+                        edge(next, sender) = 0.0;
+                        _laggedRanksSize++;
+                    }
+                }
+                inDegrees[next] = 0;
+            }
+
+            isOrdered[next] = true;
+            for (unsigned int receiver = 0; receiver < ranksSize; receiver++) {
+                if (isOrdered[receiver] == false && edge(receiver, next) > 0.0) {
+                    inDegrees[receiver]--;
+                }
+            }
+        }
+
+        for (unsigned int other = 0; other < ranksSize; other++) {
+            if (edge(rank, other) > 0.0) {
+                groups[group].recvRanks.push_back(other);
+            }
+            if (edge(other, rank) > 0.0) {
+                groups[group].sendRanks.push_back(other);
+            }
+        }
+    }
+
+    _groups = groups;
+}
+
+void SweepSchedule::compute() {
+    compute(1.0);
+}
+
+void SweepSchedule::compute(double timestepScale) {
+    if (Parallel::isSingle()) {
+        computeItems(0, _items.size(), timestepScale);
+        return;
+    }
+
+    // the same order of groups on each rank, so upwind ranks go on with next group while downwind ones take this one
+    for (unsigned int group = 0; group < _groups.size(); group++) {
+        for (auto rank : _groups[group].recvRanks) {
+            recvValues(_groups[group], rank);
+        }
+        computeItems(_groupItems[group], _groupItems[group + 1], timestepScale);
+        for (auto rank : _groups[group].sendRanks) {
+            sendValues(_groups[group], rank);
+        }
+    }
+}
+
+void SweepSchedule::computeItems(unsigned int begin, unsigned int end, double timestepScale) {
+    if (_threadsSize <= 1 || end - begin <= 1) {
+        for (unsigned int index = begin; index < end; index++) {
+            computeItem(_items[index], timestepScale);
+        }
+        return;
+    }
+
+    // workers start with first run which has items for several threads
+    if (_workers.empty()) {
+        for (unsigned int ti = 1; ti < _threadsSize; ti++) {
+            _workers.emplace_back(&SweepSchedule::work, this);
+        }
+    }
+
+    // impulses don't depend on each other, so threads only share counter of items
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _next = begin;
+        _end = end;
+        _timestepScale = timestepScale;
+        _activeSize = _workers.size();
+        _runId++;
+    }
+    _runCondition.notify_all();
+    takeItems();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this] {
+        return _activeSize == 0;
+    });
+}
+
+void SweepSchedule::work() {
+    Tracer::setThreadName("sweep");
+    unsigned long runId = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _runCondition.wait(lock, [this, runId] {
+                return _runId != runId || _isStopping;
+            });
+            if (_isStopping) {
+                return;
+            }
+            runId = _runId;
+        }
+
+        takeItems();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _activeSize--;
+        }
+        _doneCondition.notify_one();
+    }
+}
+
+void SweepSchedule::takeItems() {
+    for (auto index = _next++; index < _end; index = _next++) {
+        computeItem(_items[index], _timestepScale);
+    }
+}
+
+void SweepSchedule::computeItem(const Item& item, double timestepScale) const {
+    const auto& group = _groups[item.group];
+    for (auto ci : _orders[group.order]) {
+        auto cell = _cells[ci];
+        for (unsigned int ii = item.begin; ii < item.end; ii++) {
+            cell->computeImplicitTransfer(group.impulses[ii], timestepScale);
+        }
+    }
+}
+
+void SweepSchedule::recvValues(const Group& group, int rank) const {
+    TraceScope trace("sweep_recv", rank);
+    std::vector<double> buffer;
+    SerializationUtils::deserialize(Parallel::recv(rank, Parallel::COMMAND_SWEEP_VALUES), buffer);
+
+    unsigned int index = 0;
+    for (const auto& cell : _recvCells.at(rank)) {
+        for (auto& values : cell->getValues()) {
+            for (auto ii : group.impulses) {
+                values[ii] = buffer[index++];
+            }
+        }
+    }
+}
+
+void SweepSchedule::sendValues(const Group& group, int rank) const {
+    TraceScope trace("sweep_send", rank);
+    std::vector<double> buffer;
+    for (const auto& cell : _sendCells.at(rank)) {
+        for (const auto& values : cell->getValues()) {
+            for (auto ii : group.impulses) {
+                buffer.push_back(values[ii]);
+            }
+        }
+    }
+    Parallel::send(SerializationUtils::serialize(buffer), rank, Parallel::COMMAND_SWEEP_VALUES);
+}
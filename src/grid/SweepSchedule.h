@@ -0,0 +1,120 @@
+#ifndef RGS_SWEEPSCHEDULE_H
+#define RGS_SWEEPSCHEDULE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class BaseCell;
+class NormalCell;
+
+// Orders of normal cells for implicit transfer, each cell goes after its upwind neighbors.
+// Impulses with the same signs of projections onto all faces share one order, built once by Kahn's algorithm,
+// groups with equal orders share one vector of cell indexes.
+// With few ranks groups are the same on each rank and go in the same order: rank takes values of
+// upwind ranks, sweeps group and gives own values to downwind ranks, so ranks pipeline over groups.
+class SweepSchedule {
+public:
+    struct Group {
+        std::vector<unsigned int> impulses;
+        unsigned int order;             // index of cells order
+        std::vector<int> recvRanks;     // upwind ranks, their values come before sweep
+        std::vector<int> sendRanks;     // downwind ranks, own values go after sweep
+    };
+
+private:
+    struct Item {
+        unsigned int group;
+        unsigned int begin;     // range in group impulses
+        unsigned int end;
+    };
+
+    std::vector<NormalCell*> _cells;
+    std::vector<std::vector<unsigned int>> _orders;     // distinct orders of indexes of cells
+    std::vector<Group> _groups;
+    unsigned int _laggedSize;       // cells put out of order to break upwind cycles, they take previous values of upwind neighbors
+    unsigned int _laggedRanksSize;  // the same for ranks, lagged ranks take values of last sync
+    unsigned int _threadsSize;
+    std::vector<Item> _items;       // work for threads, impulses of one item go together over group order
+    std::vector<unsigned int> _groupItems;  // first item of each group and items size at the end
+
+    // cells next to other ranks by rank, in order of sorted ids on both sides
+    std::map<int, std::vector<BaseCell*>> _sendCells;
+    std::map<int, std::vector<BaseCell*>> _recvCells;
+
+    // workers live as long as schedule, caller thread takes items together with them
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _runCondition;
+    std::condition_variable _doneCondition;
+    unsigned long _runId;           // each range of items is new run
+    unsigned int _activeSize;       // workers which haven't finished current run
+    bool _isStopping;
+    std::atomic<unsigned int> _next;
+    unsigned int _end;
+    double _timestepScale;
+
+public:
+    // collective with few ranks, threadsSize = 0 means hardware concurrency
+    SweepSchedule(const std::vector<NormalCell*>& normalCells,
+                  const std::map<int, std::vector<BaseCell*>>& sendCells,
+                  const std::map<int, std::vector<BaseCell*>>& recvCells,
+                  unsigned int threadsSize);
+
+    ~SweepSchedule();
+
+    SweepSchedule(const SweepSchedule&) = delete;
+
+    SweepSchedule& operator=(const SweepSchedule&) = delete;
+
+    const std::vector<Group>& getGroups() const {
+        return _groups;
+    }
+
+    const std::vector<std::vector<unsigned int>>& getOrders() const {
+        return _orders;
+    }
+
+    unsigned int getLaggedSize() const {
+        return _laggedSize;
+    }
+
+    unsigned int getLaggedRanksSize() const {
+        return _laggedRanksSize;
+    }
+
+    unsigned int getThreadsSize() const {
+        return _threadsSize;
+    }
+
+    // implicit transfer of all impulses, borders must be calculated before and
+    // parallel cells synced when ranks are lagged, collective with few ranks
+    void compute();
+
+    // the same with timestep multiplied by scale
+    void compute(double timestepScale);
+
+private:
+    // splits groups on ranks into the same groups everywhere and finds ranks to exchange with
+    void initRanks(const std::vector<unsigned int>& impulseGroups,
+                   const std::vector<std::vector<bool>>& groupRecvRanks);
+
+    void computeItems(unsigned int begin, unsigned int end, double timestepScale);
+
+    void work();
+
+    // takes items of current run until they are over
+    void takeItems();
+
+    void computeItem(const Item& item, double timestepScale) const;
+
+    void recvValues(const Group& group, int rank) const;
+
+    void sendValues(const Group& group, int rank) const;
+
+};
+
+#endif //RGS_SWEEPSCHEDULE_H
@@ -0,0 +1,392 @@
+#include "SpectralCollisions.h"
+#include "core/Config.h"
+#include "parameters/ImpulseSphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+    // no aliasing of collisions when cube half side is (3 + sqrt(2)) / 2 of sphere radius
+    unsigned int computeCubeSize() {
+        auto resolution = Config::getInstance()->getImpulseSphere()->getResolution();
+        auto size = static_cast<unsigned int>(std::ceil((3 + std::sqrt(2.0)) * resolution / 2));
+        return Fft::getSmoothSize(std::max(size, resolution));
+    }
+
+    // nodes and weights of gauss-legendre quadrature over [-1, 1]
+    void getGaussLegendre(unsigned int size, std::vector<double>& nodes, std::vector<double>& weights) {
+        nodes.resize(size);
+        weights.resize(size);
+        for (unsigned int i = 0; i < size; i++) {
+            double x = std::cos(M_PI * (i + 0.75) / (size + 0.5));
+            double derivative = 1.0;
+            for (unsigned int iteration = 0; iteration < 100; iteration++) {
+                double p0 = 1.0, p1 = 0.0;
+                for (unsigned int j = 0; j < size; j++) {
+                    double p2 = p1;
+                    p1 = p0;
+                    p0 = ((2 * j + 1) * x * p1 - j * p2) / (j + 1);
+                }
+                derivative = size * (x * p0 - p1) / (x * x - 1);
+                double dx = p0 / derivative;
+                x -= dx;
+                if (std::abs(dx) < 1e-15) {
+                    break;
+                }
+            }
+            nodes[i] = x;
+            weights[i] = 2 / ((1 - x * x) * derivative * derivative);
+        }
+    }
+
+    // gauss elimination with partial pivoting, false for singular matrix
+    bool solve(std::vector<std::vector<double>>& matrix, std::vector<double>& result) {
+        auto size = matrix.size();
+        for (unsigned int k = 0; k < size; k++) {
+            unsigned int pivot = k;
+            for (unsigned int i = k + 1; i < size; i++) {
+                if (std::abs(matrix[i][k]) > std::abs(matrix[pivot][k])) {
+                    pivot = i;
+                }
+            }
+            if (std::abs(matrix[pivot][k]) < 1e-300) {
+                return false;
+            }
+            std::swap(matrix[k], matrix[pivot]);
+            for (unsigned int i = k + 1; i < size; i++) {
+                double factor = matrix[i][k] / matrix[k][k];
+                for (unsigned int j = k; j <= size; j++) {
+                    matrix[i][j] -= factor * matrix[k][j];
+                }
+            }
+        }
+        result.resize(size);
+        for (int k = size - 1; k >= 0; k--) {
+            double value = matrix[k][size];
+            for (unsigned int j = k + 1; j < size; j++) {
+                value -= matrix[k][j] * result[j];
+            }
+            result[k] = value / matrix[k][k];
+        }
+        return true;
+    }
+
+}
+
+SpectralCollisions::SpectralCollisions(unsigned int gi0, unsigned int gi1, unsigned int anglesSize)
+: _gi0(gi0), _gi1(gi1), _size(computeCubeSize()), _fft(_size) {
+    auto config = Config::getInstance();
+    const auto& gases = config->getGases();
+    auto impulseSphere = config->getImpulseSphere();
+    const auto& impulses = impulseSphere->getImpulses();
+
+    if (gi0 >= gases.size() || gi1 >= gases.size()) {
+        throw std::runtime_error("spectral collisions pair goes beyond gases");
+    }
+    if (std::abs(gases[gi0].getMass() - gases[gi1].getMass()) > 1e-12 * gases[gi0].getMass()) {
+        throw std::runtime_error("spectral collisions need equal masses of gases pair");
+    }
+    if (anglesSize == 0) {
+        throw std::runtime_error("spectral angles must be positive");
+    }
+
+    // values stay in impulse units, integral of velocity distribution is rescaled by mass^3
+    _mass = gases[gi0].getMass();
+    double diameter = (gases[gi0].getRadius() + gases[gi1].getRadius()) / 2;
+    _kernel = diameter * diameter / (std::sqrt(2.0) * M_PI) * std::pow(_mass, 3);
+
+    // velocities of impulse sphere nodes go to the middle of cube
+    double step = impulseSphere->getDeltaImpulse() / _mass;
+    _radius = 2 * impulseSphere->getMaxImpulse() / _mass;
+    _sphereBegin = (_size - impulseSphere->getResolution()) / 2;
+    _sphereEnd = _sphereBegin + impulseSphere->getResolution();
+    for (const auto& impulse : impulses) {
+        unsigned int indexes[3];
+        for (unsigned int i = 0; i < 3; i++) {
+            indexes[i] = _sphereBegin + static_cast<unsigned int>(std::round((impulse.get(i) + impulseSphere->getMaxImpulse()) / impulseSphere->getDeltaImpulse() - 0.5));
+        }
+        _cubeIndexes.push_back((indexes[0] * _size + indexes[1]) * _size + indexes[2]);
+        _sphereLines.push_back(indexes[0] * _size + indexes[1]);
+    }
+    std::sort(_sphereLines.begin(), _sphereLines.end());
+    _sphereLines.erase(std::unique(_sphereLines.begin(), _sphereLines.end()), _sphereLines.end());
+    for (unsigned int i = 0; i < _size; i++) {
+        int wave = i <= _size / 2 ? int(i) : int(i) - int(_size);
+        _waveNumbers.push_back(2 * M_PI * wave / (_size * step));
+    }
+    for (unsigned int x = 0; x < _size; x++) {
+        for (unsigned int y = 0; y < _size; y++) {
+            for (unsigned int z = 0; z < _size; z++) {
+                _waveSquares.push_back(_waveNumbers[x] * _waveNumbers[x] + _waveNumbers[y] * _waveNumbers[y] +
+                                       _waveNumbers[z] * _waveNumbers[z]);
+            }
+        }
+    }
+
+    // half sphere goes with gauss-legendre over polar cosine and midpoints over half of azimuth
+    std::vector<double> cosines, weights;
+    getGaussLegendre(anglesSize, cosines, weights);
+    for (unsigned int pi = 0; pi < anglesSize; pi++) {
+        double sine = std::sqrt(std::max(1 - cosines[pi] * cosines[pi], 0.0));
+        for (unsigned int ai = 0; ai < anglesSize; ai++) {
+            double azimuth = M_PI * (ai + 0.5) / anglesSize;
+            _directions.push_back(sine * std::cos(azimuth));
+            _directions.push_back(sine * std::sin(azimuth));
+            _directions.push_back(cosines[pi]);
+            _directions.push_back(weights[pi] * M_PI / anglesSize);
+        }
+    }
+
+    // fine tables, so linear interpolation goes within 1e-5 of multipliers
+    double maxWave = std::sqrt(3.0) * M_PI / step;
+    _tableStep = 0.01 / _radius;
+    auto tableSize = static_cast<unsigned int>(maxWave / _tableStep) + 2;
+    for (unsigned int i = 0; i < tableSize; i++) {
+        _phiTable.push_back(computePhi(_radius, i * _tableStep));
+        _psiTable.push_back(computePsi(_radius, i * _tableStep));
+    }
+
+    _lossMultipliers.resize(_size * _size * _size, 0.0);
+    for (unsigned int di = 0; di < _directions.size(); di += 4) {
+        const double* direction = &_directions[di];
+        for (unsigned int x = 0; x < _size; x++) {
+            for (unsigned int y = 0; y < _size; y++) {
+                for (unsigned int z = 0; z < _size; z++) {
+                    unsigned int index = (x * _size + y) * _size + z;
+                    double along = _waveNumbers[x] * direction[0] + _waveNumbers[y] * direction[1] + _waveNumbers[z] * direction[2];
+                    double across = std::sqrt(std::max(_waveSquares[index] - along * along, 0.0));
+                    _lossMultipliers[index] += direction[3] *
+                            interpolate(_phiTable, _tableStep, along) * interpolate(_psiTable, _tableStep, across);
+                }
+            }
+        }
+    }
+
+    _spectrum0.resize(_size * _size * _size);
+    _spectrum1.resize(_size * _size * _size);
+    _products0.resize(_size * _size * _size);
+    _products1.resize(_size * _size * _size);
+}
+
+void SpectralCollisions::compute(std::vector<double>& values0, std::vector<double>& values1, double timestepScale) {
+    auto timestep = Config::getInstance()->getTimestep() * timestepScale;
+
+    std::vector<double> integral0, integral1;
+    computeIntegral(values0, values1, integral0, integral1);
+    correctIntegral(values0, values1, integral0, integral1);
+
+    for (unsigned int ii = 0; ii < values0.size(); ii++) {
+        values0[ii] += timestep * integral0[ii];
+    }
+    if (_gi0 != _gi1) {
+        for (unsigned int ii = 0; ii < values1.size(); ii++) {
+            values1[ii] += timestep * integral1[ii];
+        }
+    }
+}
+
+double SpectralCollisions::computePhi(double radius, double s) {
+
+    // integral of |r| exp(i r s) over r in [-R, R]
+    double rs = radius * s;
+    if (std::abs(rs) < 1e-3) {
+        return radius * radius * (1 - rs * rs / 4);
+    }
+    return 2 * (radius * std::sin(rs) / s + (std::cos(rs) - 1) / (s * s));
+}
+
+double SpectralCollisions::computePsi(double radius, double s) {
+
+    // integral of phi over circle across direction, 2 pi R J1(R s) / s
+    double rs = radius * s;
+    if (std::abs(rs) < 1e-3) {
+        return M_PI * radius * radius * (1 - rs * rs / 8);
+    }
+    return 2 * M_PI * radius * ::j1(rs) / s;
+}
+
+double SpectralCollisions::interpolate(const std::vector<double>& table, double step, double s) {
+    double x = std::abs(s) / step;
+    auto i = static_cast<unsigned int>(x);
+    if (i + 1 >= table.size()) {
+        return table.back();
+    }
+    double weight = x - i;
+    return table[i] * (1 - weight) + table[i + 1] * weight;
+}
+
+void SpectralCollisions::transformValues(const std::vector<double>& values, std::vector<std::complex<double>>& spectrum) {
+    std::fill(spectrum.begin(), spectrum.end(), std::complex<double>(0.0, 0.0));
+    for (unsigned int ii = 0; ii < values.size(); ii++) {
+        spectrum[_cubeIndexes[ii]] = values[ii];
+    }
+    transformCube(spectrum, false);
+}
+
+void SpectralCollisions::transformCube(std::vector<std::complex<double>>& data, bool isInverse) {
+    unsigned int size2 = _size * _size;
+    std::vector<std::complex<double>> line(_size);
+    auto transformLine = [&](unsigned int start, unsigned int stride) {
+        for (unsigned int i = 0; i < _size; i++) {
+            line[i] = data[start + i * stride];
+        }
+        _fft.transform(line.data(), isInverse);
+        for (unsigned int i = 0; i < _size; i++) {
+            data[start + i * stride] = line[i];
+        }
+    };
+
+    // values are zero beyond lines of sphere nodes and only these lines are needed back,
+    // so last index goes over them only and middle one goes within sphere range of first index
+    auto transformLast = [&]() {
+        for (auto start : _sphereLines) {
+            _fft.transform(&data[start * _size], isInverse);
+        }
+    };
+    auto transformMiddle = [&]() {
+        for (unsigned int x = _sphereBegin; x < _sphereEnd; x++) {
+            for (unsigned int z = 0; z < _size; z++) {
+                transformLine(x * size2 + z, _size);
+            }
+        }
+    };
+    auto transformFirst = [&]() {
+        for (unsigned int yz = 0; yz < size2; yz++) {
+            transformLine(yz, size2);
+        }
+    };
+    if (isInverse) {
+        transformFirst();
+        transformMiddle();
+        transformLast();
+    } else {
+        transformLast();
+        transformMiddle();
+        transformFirst();
+    }
+}
+
+void SpectralCollisions::computeIntegral(const std::vector<double>& values0, const std::vector<double>& values1,
+                                         std::vector<double>& integral0, std::vector<double>& integral1) {
+    bool isSame = _gi0 == _gi1;
+    transformValues(values0, _spectrum0);
+    if (isSame == false) {
+        transformValues(values1, _spectrum1);
+    }
+    const auto& spectrum1 = isSame ? _spectrum0 : _spectrum1;
+    auto nodesSize = _cubeIndexes.size();
+
+    // both products are real, so one inverse transform takes them as real and imaginary parts,
+    // gain of different gases is symmetric in them
+    std::vector<double> gain(nodesSize, 0.0);
+    for (unsigned int di = 0; di < _directions.size(); di += 4) {
+        const double* direction = &_directions[di];
+        for (unsigned int x = 0; x < _size; x++) {
+            for (unsigned int y = 0; y < _size; y++) {
+                double alongXY = _waveNumbers[x] * direction[0] + _waveNumbers[y] * direction[1];
+                for (unsigned int z = 0; z < _size; z++) {
+                    unsigned int index = (x * _size + y) * _size + z;
+                    double along = alongXY + _waveNumbers[z] * direction[2];
+                    double across = std::sqrt(std::max(_waveSquares[index] - along * along, 0.0));
+                    double phi = interpolate(_phiTable, _tableStep, along);
+                    double psi = interpolate(_psiTable, _tableStep, across);
+                    _products0[index] = phi * _spectrum0[index] + std::complex<double>(0.0, psi) * spectrum1[index];
+                    if (isSame == false) {
+                        _products1[index] = phi * spectrum1[index] + std::complex<double>(0.0, psi) * _spectrum0[index];
+                    }
+                }
+            }
+        }
+        transformCube(_products0, true);
+        if (isSame == false) {
+            transformCube(_products1, true);
+        }
+        for (unsigned int ii = 0; ii < nodesSize; ii++) {
+            const auto& product0 = _products0[_cubeIndexes[ii]];
+            double value = product0.real() * product0.imag();
+            if (isSame == false) {
+                const auto& product1 = _products1[_cubeIndexes[ii]];
+                value = (value + product1.real() * product1.imag()) / 2;
+            }
+            gain[ii] += direction[3] * value;
+        }
+    }
+
+    // loss of each gas is its values times collision frequency with other gas
+    for (unsigned int index = 0; index < _lossMultipliers.size(); index++) {
+        _products0[index] = _lossMultipliers[index] * spectrum1[index];
+        if (isSame == false) {
+            _products1[index] = _lossMultipliers[index] * _spectrum0[index];
+        }
+    }
+    transformCube(_products0, true);
+    if (isSame == false) {
+        transformCube(_products1, true);
+    }
+
+    integral0.resize(nodesSize);
+    integral1.resize(isSame ? 0 : nodesSize);
+    for (unsigned int ii = 0; ii < nodesSize; ii++) {
+        unsigned int index = _cubeIndexes[ii];
+        integral0[ii] = _kernel * (gain[ii] - values0[ii] * _products0[index].real());
+        if (isSame == false) {
+            integral1[ii] = _kernel * (gain[ii] - values1[ii] * _products1[index].real());
+        }
+    }
+}
+
+void SpectralCollisions::correctIntegral(const std::vector<double>& values0, const std::vector<double>& values1,
+                                         std::vector<double>& integral0, std::vector<double>& integral1) const {
+    auto impulseSphere = Config::getInstance()->getImpulseSphere();
+    const auto& impulses = impulseSphere->getImpulses();
+    double maxImpulse = impulseSphere->getMaxImpulse();
+    bool isSame = _gi0 == _gi1;
+
+    // density of each gas, common momentum and energy, correction goes with weights of values,
+    // so empty tails stay empty
+    unsigned int size = isSame ? 5 : 6;
+    unsigned int gasesSize = isSame ? 1 : 2;
+    std::vector<std::vector<double>> matrix(size, std::vector<double>(size + 1, 0.0));
+    std::vector<double> basis(size);
+    auto getBasis = [&](unsigned int gi, unsigned int ii) {
+        Vector3d impulse = impulses[ii] / maxImpulse;
+        std::fill(basis.begin(), basis.end(), 0.0);
+        basis[gi] = 1.0;
+        basis[size - 4] = impulse.x();
+        basis[size - 3] = impulse.y();
+        basis[size - 2] = impulse.z();
+        basis[size - 1] = impulse.moduleSquare();
+    };
+    for (unsigned int gi = 0; gi < gasesSize; gi++) {
+        const auto& values = gi == 0 ? values0 : values1;
+        const auto& integral = gi == 0 ? integral0 : integral1;
+        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+            getBasis(gi, ii);
+            for (unsigned int k = 0; k < size; k++) {
+                for (unsigned int j = 0; j < size; j++) {
+                    matrix[k][j] += basis[k] * basis[j] * values[ii];
+                }
+                matrix[k][size] += basis[k] * integral[ii];
+            }
+        }
+    }
+
+    std::vector<double> coefficients;
+    if (solve(matrix, coefficients) == false) {
+        return;
+    }
+    for (unsigned int gi = 0; gi < gasesSize; gi++) {
+        const auto& values = gi == 0 ? values0 : values1;
+        auto& integral = gi == 0 ? integral0 : integral1;
+        for (unsigned int ii = 0; ii < impulses.size(); ii++) {
+            getBasis(gi, ii);
+            double correction = 0.0;
+            for (unsigned int k = 0; k < size; k++) {
+                correction += basis[k] * coefficients[k];
+            }
+            integral[ii] -= values[ii] * correction;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef RGS_SPECTRALCOLLISIONS_H
+#define RGS_SPECTRALCOLLISIONS_H
+
+#include "utilities/Fft.h"
+
+#include <complex>
+#include <vector>
+
+// Fast spectral method of hard spheres collisions for gases pair of equal masses (Mouhot, Pareschi).
+// Values of impulse sphere go into periodic cube of velocities wide enough for collisions within
+// ball of twice sphere radius to have no aliasing. Integral in Carleman form splits into products of
+// two fourier multipliers over directions of half sphere, each direction takes one inverse transform.
+// It is deterministic, so it has no noise of nodes, and it is corrected to keep density of each gas,
+// momentum and energy on impulse sphere exactly.
+class SpectralCollisions {
+private:
+    unsigned int _gi0;
+    unsigned int _gi1;
+    double _mass;
+    double _kernel;                         // hard spheres cross section in units of lambda
+    double _radius;                         // of ball of relative velocities
+    unsigned int _size;                     // of cube side
+    std::vector<unsigned int> _cubeIndexes; // of each impulse sphere node
+    std::vector<unsigned int> _sphereLines; // first two indexes of cube lines which go through sphere nodes
+    unsigned int _sphereBegin;              // range of sphere nodes indexes along each side
+    unsigned int _sphereEnd;
+    std::vector<double> _waveNumbers;       // of each index along cube side
+    std::vector<double> _waveSquares;       // of each cube node
+    std::vector<double> _directions;        // unit vector and weight of each direction of half sphere
+    std::vector<double> _lossMultipliers;   // of each cube node, sum of products over directions
+
+    // multipliers are taken from tables of argument, both are even
+    double _tableStep;
+    std::vector<double> _phiTable;          // over relative speeds along direction
+    std::vector<double> _psiTable;          // over relative speeds across direction
+
+    Fft _fft;
+    std::vector<std::complex<double>> _spectrum0;
+    std::vector<std::complex<double>> _spectrum1;
+    std::vector<std::complex<double>> _products0;
+    std::vector<std::complex<double>> _products1;
+
+public:
+    // anglesSize goes both for polar and azimuthal angles of half sphere
+    SpectralCollisions(unsigned int gi0, unsigned int gi1, unsigned int anglesSize);
+
+    // one explicit step of cell with own timestep scale, both gases change if they are different
+    void compute(std::vector<double>& values0, std::vector<double>& values1, double timestepScale);
+
+    unsigned int getCubeSize() const {
+        return _size;
+    }
+
+    unsigned int getDirectionsSize() const {
+        return _directions.size() / 4;
+    }
+
+private:
+    static double computePhi(double radius, double s);
+
+    static double computePsi(double radius, double s);
+
+    static double interpolate(const std::vector<double>& table, double step, double s);
+
+    // velocity distribution of impulse sphere values in cube and its transform
+    void transformValues(const std::vector<double>& values, std::vector<std::complex<double>>& spectrum);
+
+    // transform of cube which has values on sphere lines only, inverse one is right on sphere lines only
+    void transformCube(std::vector<std::complex<double>>& data, bool isInverse);
+
+    // collision integral of each impulse sphere node by transforms of values, second one is empty for the same gases
+    void computeIntegral(const std::vector<double>& values0, const std::vector<double>& values1,
+                         std::vector<double>& integral0, std::vector<double>& integral1);
+
+    // integral minus values times collision invariants, so integral keeps moments
+    void correctIntegral(const std::vector<double>& values0, const std::vector<double>& values1,
+                         std::vector<double>& integral0, std::vector<double>& integral1) const;
+
+};
+
+#endif //RGS_SPECTRALCOLLISIONS_H
@@ -1,6 +1,8 @@
 #include "ci.hpp"
 #include "ci_impl.hpp"
 
+#include <sstream>
+
 namespace ci {
 
     int symm;
@@ -20,6 +22,17 @@ namespace ci {
 
     void finalize() {}
 
+    std::string getRandomState() {
+        std::ostringstream os;
+        os << korobov_grid.generator();
+        return os.str();
+    }
+
+    void setRandomState(const std::string& state) {
+        std::istringstream is(state);
+        is >> korobov_grid.generator();
+    }
+
     const V3d scatter(const V3d& x, double theta, double e) {
 
         double rxy = std::sqrt(sqr(x[0]) + sqr(x[1]));
@@ -14,6 +14,8 @@ namespace ci {
         YZ_SYMM = 2 // симметрия по осям y, z
     };
 
+    struct node_calc;
+
     struct Particle {
         double d;
     };
@@ -30,8 +32,20 @@ namespace ci {
     template<typename F>
     void iter(F& f1, F& f2);
 
+    // nodes are generated for global timestep, scale stretches them to local timestep of cell
+    template<typename F>
+    void iter(F& f1, F& f2, double timestepScale);
+
+    // nodes of given gases pair instead of last generated ones
+    template<typename F>
+    void iter(const std::vector<node_calc>& nodes, F& f1, F& f2, double timestepScale);
+
     void finalize();
 
+    std::string getRandomState();
+
+    void setRandomState(const std::string& state);
+
     class Potential {
     public:
         virtual double theta(const Particle& p1, const Particle& p2, double b, double g) const = 0;
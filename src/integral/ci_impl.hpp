@@ -263,17 +263,24 @@ namespace ci {
             p.c *= B / r;
         }
 
-//        std::random_device rd;
-//        std::mt19937 gen(rd());
-//        std::shuffle(nc.begin(), nc.end(), gen);
-        std::random_shuffle(nc.begin(), nc.end());
+        std::shuffle(nc.begin(), nc.end(), korobov_grid.generator());
 
         return korobov_grid.size();
     }
 
     template<typename F>
     void iter(F& f1, F& f2) {
-        for (auto& p : nc) {
+        iter(f1, f2, 1.0);
+    }
+
+    template<typename F>
+    void iter(F& f1, F& f2, double timestepScale) {
+        iter(nc, f1, f2, timestepScale);
+    }
+
+    template<typename F>
+    void iter(const std::vector<node_calc>& nodes, F& f1, F& f2, double timestepScale) {
+        for (auto& p : nodes) {
             if (std::abs(p.r - 1) > 1e-10) {
                 sse::d2_t x, y, z, w, v;
 
@@ -292,7 +299,7 @@ namespace ci {
 
                 double rr5 = f1[p.i1];
                 double rr6 = f2[p.i2];
-                double d = (-v.d[0] * v.d[1] + rr5 * rr6) * p.c;
+                double d = (-v.d[0] * v.d[1] + rr5 * rr6) * p.c * timestepScale;
 
                 double dl = (1. - p.r) * d;
                 double dm = p.r * d;
@@ -324,7 +331,7 @@ namespace ci {
                 double g3 = f1[p.i1m];
                 double g4 = f2[p.i2m];
 
-                double d = (-g3 * g4 + g1 * g2) * p.c;
+                double d = (-g3 * g4 + g1 * g2) * p.c * timestepScale;
 
                 f1[p.i1] -= d;
                 f2[p.i2] -= d;
@@ -93,18 +93,21 @@ namespace korobov {
         }
 
         void update() {
-//            std::random_device rd;
-//            std::mt19937 gen(rd());
-//            std::uniform_real_distribution<double> urd(0, 1);
+            std::uniform_real_distribution<double> urd(0, 1);
             for (int i = 0; i < dimension; ++i) {
-//                random_shift[i] = urd(gen);
-                random_shift[i] = static_cast<double>(std::rand()) / RAND_MAX;
+                random_shift[i] = urd(gen);
             }
         }
 
+        // generator state is saved in checkpoints to repeat the same sequence after restart
+        std::mt19937& generator() {
+            return gen;
+        }
+
     private:
         int sz = 0, line = 0;
         double random_shift[dimension] {};
+        std::mt19937 gen;
     };
 
     inline void Grid::resize(int size) {
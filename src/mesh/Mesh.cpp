@@ -12,6 +12,8 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
 
 void Mesh::init() {
 
@@ -35,7 +37,28 @@ void Mesh::init() {
         }
     }
 
-    // pre-process mesh (find all neighbors) (very slow)
+    // index elements by node sets: own nodes and nodes of each side for main elements,
+    // neighbor always shares one of these sets with the side, so only candidates are checked
+    auto getKey = [](std::vector<int> nodeIds) {
+        std::sort(nodeIds.begin(), nodeIds.end());
+        std::size_t key = nodeIds.size();
+        for (auto nodeId : nodeIds) {
+            key = key * 1000003 ^ static_cast<std::size_t>(nodeId);
+        }
+        return key;
+    };
+    std::unordered_multimap<std::size_t, std::size_t> elementsIndex;
+    for (std::size_t ei = 0; ei < _elements.size(); ei++) {
+        const auto& element = _elements[ei];
+        elementsIndex.emplace(getKey(element->getNodeIds()), ei);
+        if (element->isMain() == true) {
+            for (const auto& sideElement : element->getSideElements()) {
+                elementsIndex.emplace(getKey(sideElement->getElement()->getNodeIds()), ei);
+            }
+        }
+    }
+
+    // pre-process mesh (find all neighbors)
     for (const auto& element : _elements) {
         if (element->isMain() == false) {
             continue;
@@ -44,13 +67,17 @@ void Mesh::init() {
         // find all neighbors (common nodes)
         for (const auto& sideElement : element->getSideElements()) {
 
-            // each side element can have neighbor or don't have one
-            auto predicate = [&element, &sideElement](const std::shared_ptr<Element>& otherElement) {
-                return otherElement->getId() != element->getId() && otherElement->isSideOrContainsSide(sideElement.get());
-            };
-            auto result = std::find_if(_elements.begin(), _elements.end(), predicate);
-            if (result != _elements.end()) {
-                const auto& otherElement = *result;
+            // each side element can have neighbor or don't have one, first one in elements order is taken
+            auto range = elementsIndex.equal_range(getKey(sideElement->getElement()->getNodeIds()));
+            std::size_t result = _elements.size();
+            for (auto it = range.first; it != range.second; ++it) {
+                const auto& otherElement = _elements[it->second];
+                if (it->second < result && otherElement->getId() != element->getId() && otherElement->isSideOrContainsSide(sideElement.get())) {
+                    result = it->second;
+                }
+            }
+            if (result != _elements.size()) {
+                const auto& otherElement = _elements[result];
                 sideElement->setNeighborId(otherElement->getId());
             } else {
                 std::ostringstream os;
@@ -0,0 +1,195 @@
+#include "MeshGenerator.h"
+#include "Mesh.h"
+#include "utilities/Parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+bool MeshGenerator::isGeneratorSpec(const std::string& spec) {
+    return spec.find("generate:") == 0;
+}
+
+Mesh* MeshGenerator::generate(const std::string& spec, double units) {
+    std::vector<std::string> items;
+    std::istringstream is(spec);
+    std::string item;
+    while (std::getline(is, item, ':')) {
+        items.push_back(item);
+    }
+    if (items.size() < 3 || items.size() > 4 || items[0] != "generate") {
+        throw std::runtime_error("wrong mesh generator spec: " + spec);
+    }
+
+    Shape shape;
+    if (items[1] == "box") {
+        shape = Shape::BOX;
+    } else if (items[1] == "channel") {
+        shape = Shape::CHANNEL;
+    } else if (items[1] == "tetbox") {
+        shape = Shape::TETBOX;
+    } else {
+        throw std::runtime_error("unknown mesh generator shape: " + items[1]);
+    }
+
+    unsigned int nx = 0, ny = 0, nz = 0;
+    if (std::sscanf(items[2].c_str(), "%ux%ux%u", &nx, &ny, &nz) != 3 || nx == 0 || ny == 0 || nz == 0) {
+        throw std::runtime_error("wrong mesh generator size: " + items[2]);
+    }
+
+    // other count of partitions is for single rank only, e.g. to estimate memory,
+    // each partition of parallel run must go to own rank
+    unsigned int partitions = static_cast<unsigned int>(Parallel::getSize());
+    if (items.size() == 4) {
+        partitions = static_cast<unsigned int>(std::stoul(items[3]));
+        if (partitions == 0) {
+            throw std::runtime_error("wrong mesh generator partitions: " + items[3]);
+        }
+        if (Parallel::isSingle() == false && partitions != static_cast<unsigned int>(Parallel::getSize())) {
+            throw std::runtime_error("mesh generator partitions must be equal to number of ranks: " + items[3]);
+        }
+    }
+    if (partitions > nx) {
+        if (Parallel::isMaster()) {
+            std::cout << "Warning: mesh generator partitions are reduced from " << partitions << " to " << nx
+                      << ", each partition takes at least one layer along x" << std::endl;
+        }
+        partitions = nx;
+    }
+
+    auto mesh = generate(shape, nx, ny, nz, partitions, units);
+
+    if (Parallel::isMaster()) {
+        std::cout << "Successful mesh generation: "
+                  << "shape = " << items[1] << "; "
+                  << "size = " << nx << "x" << ny << "x" << nz << "; "
+                  << "partitions = " << partitions << "; "
+                  << "number_of_elements = " << mesh->getElements().size() << std::endl << std::endl;
+    }
+
+    return mesh;
+}
+
+Mesh* MeshGenerator::generate(Shape shape, unsigned int nx, unsigned int ny, unsigned int nz, unsigned int partitions, double units) {
+    const int n[3] = {static_cast<int>(nx), static_cast<int>(ny), static_cast<int>(nz)};
+
+    auto mesh = new Mesh();
+
+    // physical groups, as gmsh would name them
+    const int mainGroup = 1, borderGroup = 2, inletGroup = 2, outletGroup = 3, wallGroup = 4;
+    mesh->addPhysicalEntity(3, mainGroup, "Main");
+    if (shape == Shape::CHANNEL) {
+        mesh->addPhysicalEntity(2, inletGroup, "BorderInlet");
+        mesh->addPhysicalEntity(2, outletGroup, "BorderOutlet");
+        mesh->addPhysicalEntity(2, wallGroup, "BorderWall");
+    } else {
+        mesh->addPhysicalEntity(2, borderGroup, "Border");
+    }
+
+    auto getNodeId = [&n](const int p[3]) {
+        return 1 + p[0] + (n[0] + 1) * (p[1] + (n[1] + 1) * p[2]);
+    };
+    auto getPartitions = [&n, partitions](int x) {
+        return std::vector<int>{static_cast<int>(static_cast<unsigned long>(x) * partitions / n[0]) + 1};
+    };
+
+    mesh->reserveNodes(static_cast<std::size_t>(n[0] + 1) * (n[1] + 1) * (n[2] + 1));
+    for (int z = 0; z <= n[2]; z++) {
+        for (int y = 0; y <= n[1]; y++) {
+            for (int x = 0; x <= n[0]; x++) {
+                const int p[3] = {x, y, z};
+                mesh->addNode(getNodeId(p), Vector3d(x * units, y * units, z * units));
+            }
+        }
+    }
+
+    std::size_t cellsSize = static_cast<std::size_t>(n[0]) * n[1] * n[2];
+    std::size_t facesSize = 2 * (static_cast<std::size_t>(n[0]) * n[1] + n[1] * n[2] + n[0] * n[2]);
+    bool isTetrahedral = shape == Shape::TETBOX;
+    mesh->reserveElements(isTetrahedral ? 6 * cellsSize + 2 * facesSize : cellsSize + facesSize);
+
+    // kuhn triangulation: each tetrahedron goes along cube axes in one of 6 orders,
+    // so neighbor cubes have the same diagonals on common faces
+    const int orders[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+    const bool isEvenOrder[6] = {true, false, false, true, true, false};
+
+    int elementId = 1;
+    for (int z = 0; z < n[2]; z++) {
+        for (int y = 0; y < n[1]; y++) {
+            for (int x = 0; x < n[0]; x++) {
+                auto partition = getPartitions(x);
+                if (isTetrahedral == false) {
+
+                    // gmsh order: bottom face counter-clockwise, then top face
+                    const int corners[8][3] = {
+                            {x, y, z}, {x + 1, y, z}, {x + 1, y + 1, z}, {x, y + 1, z},
+                            {x, y, z + 1}, {x + 1, y, z + 1}, {x + 1, y + 1, z + 1}, {x, y + 1, z + 1}
+                    };
+                    std::vector<int> nodeIds;
+                    for (const auto& corner : corners) {
+                        nodeIds.push_back(getNodeId(corner));
+                    }
+                    mesh->addElement(elementId++, static_cast<int>(Element::Type::HEXAHEDRON), mainGroup, mainGroup, partition, nodeIds);
+                } else {
+                    for (unsigned int oi = 0; oi < 6; oi++) {
+                        int p[3] = {x, y, z};
+                        std::vector<int> nodeIds{getNodeId(p)};
+                        for (auto axis : orders[oi]) {
+                            p[axis]++;
+                            nodeIds.push_back(getNodeId(p));
+                        }
+
+                        // tetrahedron sides expect positive orientation
+                        if (isEvenOrder[oi] == false) {
+                            std::swap(nodeIds[0], nodeIds[1]);
+                        }
+                        mesh->addElement(elementId++, static_cast<int>(Element::Type::TETRAHEDRON), mainGroup, mainGroup, partition, nodeIds);
+                    }
+                }
+            }
+        }
+    }
+
+    // border faces, split by the same diagonal as tetrahedrons
+    for (int c = 0; c < 3; c++) {
+        int a = (c + 1) % 3, b = (c + 2) % 3;
+        for (int side = 0; side < 2; side++) {
+            int group = borderGroup;
+            if (shape == Shape::CHANNEL) {
+                group = c == 0 ? (side == 0 ? inletGroup : outletGroup) : wallGroup;
+            }
+            for (int ia = 0; ia < n[a]; ia++) {
+                for (int ib = 0; ib < n[b]; ib++) {
+                    int p[3];
+                    p[c] = side == 0 ? 0 : n[c];
+                    p[a] = ia;
+                    p[b] = ib;
+                    int cellX = c == 0 ? (side == 0 ? 0 : n[0] - 1) : p[0];
+                    auto partition = getPartitions(cellX);
+
+                    int nodeId00 = getNodeId(p);
+                    p[a]++;
+                    int nodeId10 = getNodeId(p);
+                    p[b]++;
+                    int nodeId11 = getNodeId(p);
+                    p[a]--;
+                    int nodeId01 = getNodeId(p);
+
+                    if (isTetrahedral == false) {
+                        mesh->addElement(elementId++, static_cast<int>(Element::Type::QUADRANGLE), group, group, partition,
+                                         {nodeId00, nodeId10, nodeId11, nodeId01});
+                    } else {
+                        mesh->addElement(elementId++, static_cast<int>(Element::Type::TRIANGLE), group, group, partition,
+                                         {nodeId00, nodeId10, nodeId11});
+                        mesh->addElement(elementId++, static_cast<int>(Element::Type::TRIANGLE), group, group, partition,
+                                         {nodeId00, nodeId01, nodeId11});
+                    }
+                }
+            }
+        }
+    }
+
+    return mesh;
+}
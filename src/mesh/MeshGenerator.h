@@ -0,0 +1,33 @@
+#ifndef RGS_MESHGENERATOR_H
+#define RGS_MESHGENERATOR_H
+
+#include <string>
+
+class Mesh;
+
+// Builds structured meshes in memory instead of reading gmsh file.
+// Spec is "generate:<shape>:<NX>x<NY>x<NZ>[:<partitions>]", where shape is
+//   box     - hexahedrons, "Main" volume and "Border" faces
+//   channel - hexahedrons, "Main" volume, "BorderInlet" (x = 0), "BorderOutlet" (x = NX) and "BorderWall" faces
+//   tetbox  - box with each cube split into 6 tetrahedrons
+// Cells have unit size in mesh units. Partitions are slabs along x, one per rank, not more than NX.
+// Given count of partitions must be equal to number of ranks unless there is one rank only.
+class MeshGenerator {
+private:
+    enum class Shape {
+        BOX,
+        CHANNEL,
+        TETBOX
+    };
+
+public:
+    static bool isGeneratorSpec(const std::string& spec);
+
+    static Mesh* generate(const std::string& spec, double units);
+
+private:
+    static Mesh* generate(Shape shape, unsigned int nx, unsigned int ny, unsigned int nz, unsigned int partitions, double units);
+
+};
+
+#endif //RGS_MESHGENERATOR_H
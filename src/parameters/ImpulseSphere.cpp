@@ -2,10 +2,90 @@
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
 
 #include "ImpulseSphere.h"
 #include "core/Config.h"
 
+namespace {
+
+    // visits nodes of the sphere around impulse with trilinear weights
+    template<typename Visitor>
+    void visitNeighbours(const ImpulseSphere& sphere, const Vector3d& impulse, Visitor visitor) {
+        int resolution = static_cast<int>(sphere.getResolution());
+        int*** xyz2i = sphere.getXYZ2I();
+
+        double coords[3];
+        int lower[3];
+        for (unsigned int i = 0; i < 3; i++) {
+            coords[i] = (impulse.get(i) + sphere.getMaxImpulse()) / sphere.getDeltaImpulse() - 0.5;
+            lower[i] = static_cast<int>(std::floor(coords[i]));
+            coords[i] -= lower[i];
+        }
+
+        for (int dx = 0; dx < 2; dx++) {
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dz = 0; dz < 2; dz++) {
+                    int x = lower[0] + dx, y = lower[1] + dy, z = lower[2] + dz;
+                    if (x < 0 || x >= resolution || y < 0 || y >= resolution || z < 0 || z >= resolution) {
+                        continue;
+                    }
+                    int ii = xyz2i[x][y][z];
+                    if (ii < 0) {
+                        continue;
+                    }
+                    double weight = (dx == 1 ? coords[0] : 1 - coords[0]) *
+                                    (dy == 1 ? coords[1] : 1 - coords[1]) *
+                                    (dz == 1 ? coords[2] : 1 - coords[2]);
+                    visitor(ii, weight);
+                }
+            }
+        }
+    }
+
+    // density, momentum and energy basis
+    void getMomentBasis(const Vector3d& impulse, double basis[5]) {
+        basis[0] = 1.0;
+        basis[1] = impulse.x();
+        basis[2] = impulse.y();
+        basis[3] = impulse.z();
+        basis[4] = impulse.moduleSquare();
+    }
+
+    // gauss elimination with partial pivoting, matrix and rhs are spoiled
+    bool solve(double matrix[5][5], double rhs[5], double result[5]) {
+        for (unsigned int col = 0; col < 5; col++) {
+            unsigned int pivot = col;
+            for (unsigned int row = col + 1; row < 5; row++) {
+                if (std::abs(matrix[row][col]) > std::abs(matrix[pivot][col])) {
+                    pivot = row;
+                }
+            }
+            if (std::abs(matrix[pivot][col]) < 1e-300) {
+                return false;
+            }
+            std::swap(matrix[col], matrix[pivot]);
+            std::swap(rhs[col], rhs[pivot]);
+            for (unsigned int row = col + 1; row < 5; row++) {
+                double factor = matrix[row][col] / matrix[col][col];
+                for (unsigned int k = col; k < 5; k++) {
+                    matrix[row][k] -= factor * matrix[col][k];
+                }
+                rhs[row] -= factor * rhs[col];
+            }
+        }
+        for (int row = 4; row >= 0; row--) {
+            double sum = rhs[row];
+            for (unsigned int k = row + 1; k < 5; k++) {
+                sum -= matrix[row][k] * result[k];
+            }
+            result[row] = sum / matrix[row][row];
+        }
+        return true;
+    }
+
+}
+
 void ImpulseSphere::init() {
 
     // calc delta impulse
@@ -28,6 +108,10 @@ void ImpulseSphere::init() {
                 Vector3d impulse = {lineImpulses[x], lineImpulses[y], lineImpulses[z]};
                 if (impulse.module() < _maxImpulse) {
                     _impulses.push_back(impulse);
+                    _impulsesX.push_back(impulse.x());
+                    _impulsesY.push_back(impulse.y());
+                    _impulsesZ.push_back(impulse.z());
+                    _impulseSquares.push_back(impulse.moduleSquare());
                     _i2xyz.emplace_back(x, y, z);
                     _xyz2i[x][y][z] = static_cast<int>(_i2xyz.size() - 1);
                 } else {
@@ -38,6 +122,62 @@ void ImpulseSphere::init() {
     }
 }
 
+void ImpulseSphere::computeMoments(const std::vector<double>& values, double moments[MOMENTS_SIZE]) const {
+
+    // each lane sums own nodes, so lanes go as one vector without reordering of sums
+    const unsigned int LANES_SIZE = 4;
+    double sums[MOMENTS_SIZE][LANES_SIZE] = {};
+    const double* x = _impulsesX.data();
+    const double* y = _impulsesY.data();
+    const double* z = _impulsesZ.data();
+    const double* square = _impulseSquares.data();
+    const double* value = values.data();
+
+    unsigned int size = _impulses.size();
+    unsigned int lanesEnd = size - size % LANES_SIZE;
+    for (unsigned int ii = 0; ii < lanesEnd; ii += LANES_SIZE) {
+        for (unsigned int l = 0; l < LANES_SIZE; l++) {
+            double f = value[ii + l];
+            double energy = square[ii + l] * f;
+            sums[0][l] += f;
+            sums[1][l] += x[ii + l] * f;
+            sums[2][l] += y[ii + l] * f;
+            sums[3][l] += z[ii + l] * f;
+            sums[4][l] += energy;
+            sums[5][l] += x[ii + l] * energy;
+            sums[6][l] += y[ii + l] * energy;
+            sums[7][l] += z[ii + l] * energy;
+        }
+    }
+    for (unsigned int ii = lanesEnd; ii < size; ii++) {
+        double f = value[ii];
+        double energy = square[ii] * f;
+        sums[0][0] += f;
+        sums[1][0] += x[ii] * f;
+        sums[2][0] += y[ii] * f;
+        sums[3][0] += z[ii] * f;
+        sums[4][0] += energy;
+        sums[5][0] += x[ii] * energy;
+        sums[6][0] += y[ii] * energy;
+        sums[7][0] += z[ii] * energy;
+    }
+
+    for (unsigned int k = 0; k < MOMENTS_SIZE; k++) {
+        moments[k] = (sums[k][0] + sums[k][1] + sums[k][2] + sums[k][3]) * _deltaImpulseQube;
+    }
+}
+
+void ImpulseSphere::computeMaxwellianFactors(double mass, const Vector3d& velocity, double temperature, std::vector<double>& factors) const {
+    factors.resize(3 * _resolution);
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        double shift = mass * velocity.get(axis);
+        for (unsigned int i = 0; i < _resolution; i++) {
+            double impulse = _deltaImpulse * (i + 0.5) - _maxImpulse - shift;
+            factors[axis * _resolution + i] = std::exp(-impulse * impulse / mass / 2 / temperature);
+        }
+    }
+}
+
 int ImpulseSphere::reverseIndex(int ii, const Vector3d& normal) {
     Vector3d impulse = _impulses[ii];
     Vector3d reverseImpulse = impulse - normal * impulse.scalar(normal) * 2;
@@ -53,6 +193,94 @@ int ImpulseSphere::reverseIndex(int ii, const Vector3d& normal) {
     return _xyz2i[x][y][z];
 }
 
+std::vector<double> ImpulseSphere::interpolate(const ImpulseSphere& from, const std::vector<double>& fromValues) const {
+    std::vector<double> values(_impulses.size(), 0.0);
+
+    if (_deltaImpulse < from._deltaImpulse) {
+
+        // finer grid: take trilinear interpolation of coarse values in each node
+        for (unsigned int ii = 0; ii < _impulses.size(); ii++) {
+            visitNeighbours(from, _impulses[ii], [&](int fromIi, double weight) {
+                values[ii] += weight * fromValues[fromIi];
+            });
+        }
+    } else {
+
+        // coarser grid: spread mass of each fine node to nearest coarse nodes (cloud in cell)
+        for (unsigned int fromIi = 0; fromIi < from._impulses.size(); fromIi++) {
+            double mass = fromValues[fromIi] * from._deltaImpulseQube;
+            Vector3d impulse = from._impulses[fromIi];
+
+            double weightSum = 0.0;
+            visitNeighbours(*this, impulse, [&](int /*ii*/, double weight) {
+                weightSum += weight;
+            });
+            if (weightSum == 0.0) {
+
+                // node is out of the sphere, move it inside to keep mass
+                impulse *= (_maxImpulse - _deltaImpulse) / impulse.module();
+                visitNeighbours(*this, impulse, [&](int /*ii*/, double weight) {
+                    weightSum += weight;
+                });
+            }
+            visitNeighbours(*this, impulse, [&](int ii, double weight) {
+                values[ii] += mass * weight / weightSum;
+            });
+        }
+        for (auto& value : values) {
+            value /= _deltaImpulseQube;
+        }
+    }
+
+    // fix moments: values *= 1 + a * basis, where a is found from 5x5 system
+    double fromMoments[MOMENTS_SIZE], moments[MOMENTS_SIZE];
+    from.computeMoments(fromValues, fromMoments);
+    computeMoments(values, moments);
+
+    double matrix[5][5] = {};
+    double rhs[5], coeffs[5];
+    double basis[5];
+    for (unsigned int ii = 0; ii < _impulses.size(); ii++) {
+        getMomentBasis(_impulses[ii], basis);
+        for (unsigned int i = 0; i < 5; i++) {
+            for (unsigned int j = 0; j < 5; j++) {
+                matrix[i][j] += values[ii] * basis[i] * basis[j] * _deltaImpulseQube;
+            }
+        }
+    }
+    for (unsigned int k = 0; k < 5; k++) {
+        rhs[k] = fromMoments[k] - moments[k];
+    }
+    if (solve(matrix, rhs, coeffs) == true) {
+        bool isClamped = false;
+        for (unsigned int ii = 0; ii < _impulses.size(); ii++) {
+            getMomentBasis(_impulses[ii], basis);
+            double factor = 1.0;
+            for (unsigned int k = 0; k < 5; k++) {
+                factor += coeffs[k] * basis[k];
+            }
+            values[ii] *= factor;
+            if (values[ii] < 0.0) {
+                values[ii] = 0.0;
+                isClamped = true;
+            }
+        }
+
+        // factor can go below zero in tails, values are cut there and density is kept
+        if (isClamped == true) {
+            computeMoments(values, moments);
+            if (moments[0] > 0.0) {
+                double scale = fromMoments[0] / moments[0];
+                for (auto& value : values) {
+                    value *= scale;
+                }
+            }
+        }
+    }
+
+    return values;
+}
+
 std::ostream& operator<<(std::ostream& os, const ImpulseSphere& impulse) {
     os << "{";
     os << "MaxImpulse = " << impulse._maxImpulse << "; "
@@ -15,10 +15,19 @@ private:
     double _deltaImpulse;
     double _deltaImpulseQube;
     std::vector<Vector3d> _impulses;
+
+    // components and square of each impulse apart, so moment loops go over plain arrays
+    std::vector<double> _impulsesX;
+    std::vector<double> _impulsesY;
+    std::vector<double> _impulsesZ;
+    std::vector<double> _impulseSquares;
     std::vector<Vector3i> _i2xyz;
     int*** _xyz2i;
 
 public:
+    // density, momentum, energy and energy flux, see computeMoments
+    static const unsigned int MOMENTS_SIZE = 8;
+
     ImpulseSphere() = default;
 
     ImpulseSphere(double maxImpulse, unsigned int resolution) : _maxImpulse(maxImpulse), _resolution(resolution) {}
@@ -61,8 +70,42 @@ public:
         return _impulses;
     }
 
+    const std::vector<double>& getImpulsesX() const {
+        return _impulsesX;
+    }
+
+    const std::vector<double>& getImpulsesY() const {
+        return _impulsesY;
+    }
+
+    const std::vector<double>& getImpulsesZ() const {
+        return _impulsesZ;
+    }
+
+    const std::vector<double>& getImpulseSquares() const {
+        return _impulseSquares;
+    }
+
+    // maxwellian exp(-(p - m u)^2 / 2mT) is product of factors of impulse components,
+    // factors go by axis and by index along it, 3 * resolution exponents for whole sphere
+    void computeMaxwellianFactors(double mass, const Vector3d& velocity, double temperature, std::vector<double>& factors) const;
+
+    // maxwellian of impulse by its factors, not normalized
+    double getMaxwellian(const std::vector<double>& factors, unsigned int ii) const {
+        const auto& xyz = _i2xyz[ii];
+        return factors[xyz.x()] * factors[_resolution + xyz.y()] * factors[2 * _resolution + xyz.z()];
+    }
+
+    // raw moments of values in one pass, each times delta impulse qube:
+    // sum of values, of impulse (3), of impulse square and of impulse by its square (3)
+    void computeMoments(const std::vector<double>& values, double moments[MOMENTS_SIZE]) const;
+
     int reverseIndex(int ii, const Vector3d& normal);
 
+    // moves distribution given on other sphere to this one, density, momentum and energy
+    // are kept exactly unless correction gives negative values, then density only is kept
+    std::vector<double> interpolate(const ImpulseSphere& from, const std::vector<double>& fromValues) const;
+
     friend std::ostream& operator<<(std::ostream& os, const ImpulseSphere& impulse);
 
 private:
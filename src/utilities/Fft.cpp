@@ -0,0 +1,160 @@
+#include "Fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Fft::Fft(unsigned int size) : _size(size) {
+    if (size == 0) {
+        throw std::runtime_error("fft size must be positive");
+    }
+
+    // fours go first, then twos and odd factors
+    unsigned int rest = size;
+    unsigned int radix = 4;
+    while (rest > 1) {
+        while (rest % radix != 0) {
+            if (radix == 4) {
+                radix = 2;
+            } else if (radix == 2) {
+                radix = 3;
+            } else {
+                radix += 2;
+            }
+            if (radix * radix > rest) {
+                radix = rest;
+            }
+        }
+        rest /= radix;
+        _factors.push_back(radix);
+        _factors.push_back(rest);
+    }
+
+    for (unsigned int i = 0; i < size; i++) {
+        _forwardTwiddles.push_back(std::polar(1.0, -2 * M_PI * i / size));
+        _inverseTwiddles.push_back(std::conj(_forwardTwiddles.back()));
+    }
+    _isInverse = false;
+    _twiddles = _forwardTwiddles.data();
+    _line.resize(size);
+    _scratch.resize(size);
+}
+
+void Fft::transform(std::complex<double>* data, bool isInverse) {
+    _isInverse = isInverse;
+    _twiddles = isInverse ? _inverseTwiddles.data() : _forwardTwiddles.data();
+    std::copy(data, data + _size, _line.begin());
+    if (_size == 1) {
+        data[0] = _line[0];
+    } else {
+        work(data, _line.data(), 1, 0);
+    }
+    if (isInverse) {
+        double scale = 1.0 / _size;
+        for (unsigned int i = 0; i < _size; i++) {
+            data[i] *= scale;
+        }
+    }
+}
+
+unsigned int Fft::getSmoothSize(unsigned int size) {
+    for (unsigned int candidate = std::max(size, 1u);; candidate++) {
+        unsigned int rest = candidate;
+        for (unsigned int factor : {2u, 3u, 5u}) {
+            while (rest % factor == 0) {
+                rest /= factor;
+            }
+        }
+        if (rest == 1) {
+            return candidate;
+        }
+    }
+}
+
+void Fft::work(std::complex<double>* out, const std::complex<double>* in, unsigned int stride, unsigned int stage) {
+    unsigned int radix = _factors[stage * 2];
+    unsigned int m = _factors[stage * 2 + 1];
+
+    // decimation in time: each of radix subsequences goes to own part of output
+    if (m == 1) {
+        for (unsigned int q = 0; q < radix; q++) {
+            out[q] = in[q * stride];
+        }
+    } else {
+        for (unsigned int q = 0; q < radix; q++) {
+            work(out + q * m, in + q * stride, stride * radix, stage + 1);
+        }
+    }
+
+    if (radix == 2) {
+        butterfly2(out, stride, m);
+    } else if (radix == 3) {
+        butterfly3(out, stride, m);
+    } else if (radix == 4) {
+        butterfly4(out, stride, m);
+    } else {
+        butterflyGeneric(out, stride, radix, m);
+    }
+}
+
+void Fft::butterfly2(std::complex<double>* out, unsigned int stride, unsigned int m) {
+    for (unsigned int k = 0; k < m; k++) {
+        std::complex<double> t = out[k + m] * _twiddles[k * stride];
+        out[k + m] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+void Fft::butterfly3(std::complex<double>* out, unsigned int stride, unsigned int m) {
+    double sine = _twiddles[stride * m].imag();
+    for (unsigned int k = 0; k < m; k++) {
+        std::complex<double> s1 = out[k + m] * _twiddles[k * stride];
+        std::complex<double> s2 = out[k + 2 * m] * _twiddles[2 * k * stride];
+        std::complex<double> s3 = s1 + s2;
+        std::complex<double> s0 = (s1 - s2) * sine;
+        std::complex<double> middle = out[k] - s3 * 0.5;
+        out[k] += s3;
+        out[k + m] = std::complex<double>(middle.real() - s0.imag(), middle.imag() + s0.real());
+        out[k + 2 * m] = std::complex<double>(middle.real() + s0.imag(), middle.imag() - s0.real());
+    }
+}
+
+void Fft::butterfly4(std::complex<double>* out, unsigned int stride, unsigned int m) {
+    for (unsigned int k = 0; k < m; k++) {
+        std::complex<double> s0 = out[k + m] * _twiddles[k * stride];
+        std::complex<double> s1 = out[k + 2 * m] * _twiddles[2 * k * stride];
+        std::complex<double> s2 = out[k + 3 * m] * _twiddles[3 * k * stride];
+        std::complex<double> s5 = out[k] - s1;
+        out[k] += s1;
+        std::complex<double> s3 = s0 + s2;
+        std::complex<double> s4 = s0 - s2;
+        out[k + 2 * m] = out[k] - s3;
+        out[k] += s3;
+        if (_isInverse) {
+            out[k + m] = std::complex<double>(s5.real() - s4.imag(), s5.imag() + s4.real());
+            out[k + 3 * m] = std::complex<double>(s5.real() + s4.imag(), s5.imag() - s4.real());
+        } else {
+            out[k + m] = std::complex<double>(s5.real() + s4.imag(), s5.imag() - s4.real());
+            out[k + 3 * m] = std::complex<double>(s5.real() - s4.imag(), s5.imag() + s4.real());
+        }
+    }
+}
+
+void Fft::butterflyGeneric(std::complex<double>* out, unsigned int stride, unsigned int radix, unsigned int m) {
+    for (unsigned int u = 0; u < m; u++) {
+        for (unsigned int q = 0; q < radix; q++) {
+            _scratch[q] = out[u + q * m];
+        }
+        for (unsigned int q = 0; q < radix; q++) {
+            unsigned int k = u + q * m;
+            unsigned int twiddle = 0;
+            std::complex<double> sum = _scratch[0];
+            for (unsigned int p = 1; p < radix; p++) {
+                twiddle += stride * k;
+                twiddle %= _size;
+                sum += _scratch[p] * _twiddles[twiddle];
+            }
+            out[k] = sum;
+        }
+    }
+}
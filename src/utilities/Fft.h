@@ -0,0 +1,47 @@
+#ifndef RGS_FFT_H
+#define RGS_FFT_H
+
+#include <complex>
+#include <vector>
+
+// Mixed radix fast fourier transform of fixed size, radix 2, 3 and 4 go with own butterflies,
+// other factors go by plain sums, so sizes of small primes only are fast.
+// Forward transform has minus in exponent and no scale, inverse one is scaled by 1 / size.
+class Fft {
+private:
+    unsigned int _size;
+    std::vector<unsigned int> _factors;     // radix and size of rest after it, one pair by stage
+    std::vector<std::complex<double>> _forwardTwiddles;
+    std::vector<std::complex<double>> _inverseTwiddles;
+    bool _isInverse;                        // current direction of transform
+    const std::complex<double>* _twiddles;  // of current direction
+    std::vector<std::complex<double>> _line;
+    std::vector<std::complex<double>> _scratch;
+
+public:
+    explicit Fft(unsigned int size);
+
+    unsigned int getSize() const {
+        return _size;
+    }
+
+    // transform of size values in place
+    void transform(std::complex<double>* data, bool isInverse);
+
+    // least size which is not less than given one and has factors 2, 3 and 5 only
+    static unsigned int getSmoothSize(unsigned int size);
+
+private:
+    void work(std::complex<double>* out, const std::complex<double>* in, unsigned int stride, unsigned int stage);
+
+    void butterfly2(std::complex<double>* out, unsigned int stride, unsigned int m);
+
+    void butterfly3(std::complex<double>* out, unsigned int stride, unsigned int m);
+
+    void butterfly4(std::complex<double>* out, unsigned int stride, unsigned int m);
+
+    void butterflyGeneric(std::complex<double>* out, unsigned int stride, unsigned int radix, unsigned int m);
+
+};
+
+#endif //RGS_FFT_H
@@ -59,3 +59,23 @@ void Parallel::abort() {
 void Parallel::barrier() {
     MPI_Barrier(MPI_COMM_WORLD);
 }
+
+std::vector<double> Parallel::allReduce(const std::vector<double>& values, Reduce reduce) {
+    std::vector<double> result(values.size());
+
+    MPI_Op op = MPI_SUM;
+    switch (reduce) {
+        case Reduce::MIN:
+            op = MPI_MIN;
+            break;
+        case Reduce::MAX:
+            op = MPI_MAX;
+            break;
+        case Reduce::SUM:
+            op = MPI_SUM;
+            break;
+    }
+    MPI_Allreduce(values.data(), result.data(), static_cast<int>(values.size()), MPI_DOUBLE, op, MPI_COMM_WORLD);
+
+    return result;
+}
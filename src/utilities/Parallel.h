@@ -2,6 +2,7 @@
 #define PARALLEL_H
 
 #include <string>
+#include <vector>
 
 class Parallel {
 public:
@@ -9,13 +10,23 @@ public:
     static const int COMMAND_TIMESTEP               = 110;
     static const int COMMAND_CONFIG                 = 120;
     static const int COMMAND_MESSAGE                = 130;
+    static const int COMMAND_OUTPUT_FOLDER          = 140;
+    static const int COMMAND_TRACE_EVENTS           = 150;
     static const int COMMAND_SYNC_IDS               = 200;
     static const int COMMAND_SYNC_VALUES            = 210;
     static const int COMMAND_SYNC_HALF_VALUES       = 220;
+    static const int COMMAND_SYNC_LEVELS            = 230;
+    static const int COMMAND_SWEEP_VALUES           = 240;
     static const int COMMAND_RESULT_PARAMS          = 300;
     static const int COMMAND_BUFFER_RESULTS         = 310;
     static const int COMMAND_BUFFER_AVERAGE_RESULTS = 320;
 
+    enum class Reduce {
+        MIN,
+        MAX,
+        SUM
+    };
+
 private:
     static bool _isUsingMPI;
     static bool _isSingle;
@@ -36,6 +47,9 @@ public:
 
     static void barrier();
 
+    // element wise reduction over all ranks, result is available on each rank
+    static std::vector<double> allReduce(const std::vector<double>& values, Reduce reduce);
+
     static bool isUsingMPI() {
         return _isUsingMPI;
     }
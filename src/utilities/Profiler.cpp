@@ -0,0 +1,122 @@
+#include "Profiler.h"
+#include "Parallel.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+bool Profiler::_isEnabled = false;
+std::mutex Profiler::_mutex{};
+std::vector<double> Profiler::_totalTimes(Profiler::PHASES_SIZE, 0.0);
+std::vector<double> Profiler::_windowTimes(Profiler::PHASES_SIZE, 0.0);
+unsigned int Profiler::_windowStart = 1;
+
+void Profiler::setEnabled(bool isEnabled) {
+    _isEnabled = isEnabled;
+}
+
+void Profiler::add(Phase phase, double seconds) {
+
+    // output is timed from writer thread as well
+    std::lock_guard<std::mutex> lock(_mutex);
+    _totalTimes[static_cast<unsigned int>(phase)] += seconds;
+    _windowTimes[static_cast<unsigned int>(phase)] += seconds;
+}
+
+void Profiler::report(unsigned int iteration) {
+    std::vector<double> times;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        times = _windowTimes;
+        std::fill(_windowTimes.begin(), _windowTimes.end(), 0.0);
+    }
+
+    std::stringstream title;
+    title << "Profile of iterations " << _windowStart << "-" << iteration;
+    print(title.str(), times);
+
+    _windowStart = iteration + 1;
+}
+
+void Profiler::reportTotal(unsigned int iteration) {
+    std::vector<double> times;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        times = _totalTimes;
+    }
+
+    std::stringstream title;
+    title << "Profile of whole run, " << iteration << " iterations";
+    print(title.str(), times);
+}
+
+const char* Profiler::getPhaseName(Phase phase) {
+    switch (phase) {
+        case Phase::ITERATION:
+            return "iteration";
+        case Phase::TRANSFER:
+            return "transfer";
+        case Phase::SYNC:
+            return "sync";
+        case Phase::BORDER:
+            return "border";
+        case Phase::AVERAGE_FLOW:
+            return "average_flow";
+        case Phase::COLLISION_GEN:
+            return "ci_gen";
+        case Phase::CELL_OPERATORS:
+            return "cell_ops";
+        case Phase::CHECK:
+            return "check";
+        case Phase::OUTPUT:
+            return "output";
+        case Phase::OUTPUT_WRITE:
+            return "output_write";
+        case Phase::CHECKPOINT:
+            return "checkpoint";
+    }
+    return "";
+}
+
+void Profiler::print(const std::string& title, const std::vector<double>& times) {
+    std::vector<double> minTimes = times, maxTimes = times, sumTimes = times;
+    if (Parallel::isSingle() == false) {
+        minTimes = Parallel::allReduce(times, Parallel::Reduce::MIN);
+        maxTimes = Parallel::allReduce(times, Parallel::Reduce::MAX);
+        sumTimes = Parallel::allReduce(times, Parallel::Reduce::SUM);
+    }
+
+    if (Parallel::isMaster() == false) {
+        return;
+    }
+
+    double iterationTime = sumTimes[static_cast<unsigned int>(Phase::ITERATION)] / Parallel::getSize();
+
+    // imbalance is max / mean, 1.0 means all ranks spent the same time
+    std::stringstream ss;
+    ss << std::endl << title << " (seconds, " << Parallel::getSize() << " ranks):" << std::endl;
+    ss << std::left << std::setw(14) << "phase"
+       << std::right << std::setw(12) << "min"
+       << std::setw(12) << "mean"
+       << std::setw(12) << "max"
+       << std::setw(12) << "imbalance"
+       << std::setw(10) << "share" << std::endl;
+    for (unsigned int pi = 0; pi < PHASES_SIZE; pi++) {
+        double mean = sumTimes[pi] / Parallel::getSize();
+        if (maxTimes[pi] == 0.0) {
+            continue;
+        }
+        ss << std::left << std::setw(14) << getPhaseName(static_cast<Phase>(pi))
+           << std::right << std::fixed << std::setprecision(4)
+           << std::setw(12) << minTimes[pi]
+           << std::setw(12) << mean
+           << std::setw(12) << maxTimes[pi]
+           << std::setprecision(2)
+           << std::setw(12) << (mean > 0.0 ? maxTimes[pi] / mean : 1.0)
+           << std::setprecision(1)
+           << std::setw(9) << (iterationTime > 0.0 ? 100.0 * mean / iterationTime : 0.0) << "%"
+           << std::endl;
+    }
+    std::cout << ss.str();
+    std::cout.flush();
+}
@@ -0,0 +1,100 @@
+#ifndef RGS_PROFILER_H
+#define RGS_PROFILER_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Tracer.h"
+
+// Accumulates wall time of solver phases on each rank.
+// When profiler and tracer are disabled, each timer costs a single branch.
+class Profiler {
+public:
+    enum class Phase {
+        ITERATION,      // whole solver step
+        TRANSFER,       // normal cells transfer
+        SYNC,           // parallel cells exchange
+        BORDER,         // border cells transfer
+        AVERAGE_FLOW,   // flows gathering on master
+        COLLISION_GEN,  // ci::gen
+        CELL_OPERATORS, // collisions, beta decay and check of each cell in one sweep, ci::gen goes inside,
+                        // checks are off on trial steps of newton and multigrid
+        CHECK,
+        OUTPUT,         // results copy and push to writer
+        OUTPUT_WRITE,   // writing files in writer thread
+        CHECKPOINT
+    };
+
+    static const unsigned int PHASES_SIZE = static_cast<unsigned int>(Phase::CHECKPOINT) + 1;
+
+private:
+    static bool _isEnabled;
+    static std::mutex _mutex;
+    static std::vector<double> _totalTimes;
+    static std::vector<double> _windowTimes;
+    static unsigned int _windowStart;
+
+public:
+    static void setEnabled(bool isEnabled);
+
+    static bool isEnabled() {
+        return _isEnabled;
+    }
+
+    static void add(Phase phase, double seconds);
+
+    // collective, prints min/mean/max over ranks of times since previous report
+    static void report(unsigned int iteration);
+
+    // collective, prints min/mean/max over ranks of whole run times
+    static void reportTotal(unsigned int iteration);
+
+    static const char* getPhaseName(Phase phase);
+
+private:
+    static void print(const std::string& title, const std::vector<double>& times);
+
+};
+
+class ScopedTimer {
+private:
+    Profiler::Phase _phase;
+    bool _isEnabled;
+    bool _isTracing;
+    std::chrono::steady_clock::time_point _start;
+
+public:
+    explicit ScopedTimer(Profiler::Phase phase) : _phase(phase), _isEnabled(Profiler::isEnabled()), _isTracing(Tracer::isActive()) {
+        if (_isEnabled || _isTracing) {
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer() {
+        stop();
+    }
+
+    // finishes timing before end of scope
+    void stop() {
+        if (_isEnabled || _isTracing) {
+            auto end = std::chrono::steady_clock::now();
+            if (_isEnabled) {
+                std::chrono::duration<double> duration = end - _start;
+                Profiler::add(_phase, duration.count());
+            }
+            if (_isTracing) {
+                Tracer::add(Profiler::getPhaseName(_phase), _start, end);
+            }
+            _isEnabled = false;
+            _isTracing = false;
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+#endif //RGS_PROFILER_H
@@ -0,0 +1,123 @@
+#include "Tracer.h"
+#include "Parallel.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+bool Tracer::_isEnabled = false;
+std::atomic<bool> Tracer::_isActive{false};
+unsigned int Tracer::_startIteration = 0;
+unsigned int Tracer::_endIteration = 0;
+std::chrono::steady_clock::time_point Tracer::_origin{};
+
+std::mutex Tracer::_mutex{};
+std::vector<Tracer::Event> Tracer::_events{};
+std::map<std::thread::id, int> Tracer::_threads{};
+std::vector<std::string> Tracer::_threadNames{};
+
+void Tracer::setEnabled(bool isEnabled, unsigned int startIteration, unsigned int endIteration) {
+    _isEnabled = isEnabled;
+    _startIteration = startIteration;
+    _endIteration = endIteration;
+
+    // solver thread goes first, before writer thread is started
+    if (_isEnabled) {
+        setThreadName("solver");
+    }
+}
+
+void Tracer::start() {
+    if (_isEnabled == false) {
+        return;
+    }
+    if (Parallel::isSingle() == false) {
+        Parallel::barrier();
+    }
+    _origin = std::chrono::steady_clock::now();
+}
+
+void Tracer::setIteration(unsigned int iteration) {
+    _isActive = _isEnabled && iteration >= _startIteration && (_endIteration == 0 || iteration <= _endIteration);
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _threadNames[getThread()] = name;
+}
+
+void Tracer::add(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, int peer) {
+    std::chrono::duration<double, std::micro> startTime = start - _origin;
+    std::chrono::duration<double, std::micro> duration = end - start;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _events.push_back({name, getThread(), startTime.count(), duration.count(), peer});
+}
+
+void Tracer::write(const std::string& filename) {
+    if (_isEnabled == false) {
+        return;
+    }
+    _isActive = false;
+
+    std::string events = toJson();
+
+    if (Parallel::isMaster() == true) {
+        for (int rank = 1; rank < Parallel::getSize(); rank++) {
+            std::string otherEvents = Parallel::recv(rank, Parallel::COMMAND_TRACE_EVENTS);
+            if (otherEvents.empty() == false) {
+                events += events.empty() ? otherEvents : ",\n" + otherEvents;
+            }
+        }
+
+        std::ofstream fs(filename, std::ios::out | std::ios::trunc);
+        if (fs.is_open() == false) {
+            throw std::runtime_error("can't open trace file: " + filename);
+        }
+        fs << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" << events << "\n]}\n";
+        std::cout << "Trace written: " << filename << std::endl;
+    } else {
+        Parallel::send(events, 0, Parallel::COMMAND_TRACE_EVENTS);
+    }
+}
+
+int Tracer::getThread() {
+
+    // called under lock
+    auto id = std::this_thread::get_id();
+    auto pos = _threads.find(id);
+    if (pos == _threads.end()) {
+        pos = _threads.emplace(id, static_cast<int>(_threads.size())).first;
+        _threadNames.emplace_back("thread " + std::to_string(pos->second));
+    }
+    return pos->second;
+}
+
+std::string Tracer::toJson() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    int rank = Parallel::getRank();
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+
+    // names of process and threads
+    ss << R"({"ph": "M", "name": "process_name", "pid": )" << rank << R"(, "args": {"name": "rank )" << rank << "\"}}";
+    for (unsigned int ti = 0; ti < _threadNames.size(); ti++) {
+        ss << ",\n" << R"({"ph": "M", "name": "thread_name", "pid": )" << rank << ", \"tid\": " << ti
+           << R"(, "args": {"name": ")" << _threadNames[ti] << "\"}}";
+    }
+
+    for (const auto& event : _events) {
+        ss << ",\n" << R"({"ph": "X", "name": ")" << event.name << "\", \"pid\": " << rank << ", \"tid\": " << event.thread
+           << ", \"ts\": " << event.start << ", \"dur\": " << event.duration;
+        if (event.peer >= 0) {
+            ss << R"(, "args": {"rank": )" << event.peer << "}";
+        }
+        ss << "}";
+    }
+    _events.clear();
+
+    return ss.str();
+}
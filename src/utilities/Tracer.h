@@ -0,0 +1,89 @@
+#ifndef RGS_TRACER_H
+#define RGS_TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records timed events of solver phases in Chrome trace format (chrome://tracing, Perfetto).
+// Process is mpi rank, thread is solver or writer thread.
+class Tracer {
+private:
+    struct Event {
+        const char* name;
+        int thread;
+        double start;   // microseconds from trace start
+        double duration;
+        int peer;       // other rank of message exchange, -1 if none
+    };
+
+    static bool _isEnabled;
+    static std::atomic<bool> _isActive;
+    static unsigned int _startIteration;
+    static unsigned int _endIteration;
+    static std::chrono::steady_clock::time_point _origin;
+
+    static std::mutex _mutex;
+    static std::vector<Event> _events;
+    static std::map<std::thread::id, int> _threads;
+    static std::vector<std::string> _threadNames;
+
+public:
+
+    // events are kept only for iterations from start to end, end = 0 means up to the last one
+    static void setEnabled(bool isEnabled, unsigned int startIteration, unsigned int endIteration);
+
+    // collective, aligns time origin of all ranks
+    static void start();
+
+    static void setIteration(unsigned int iteration);
+
+    static bool isActive() {
+        return _isActive.load(std::memory_order_relaxed);
+    }
+
+    static void setThreadName(const std::string& name);
+
+    static void add(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, int peer = -1);
+
+    // collective, master gathers events of all ranks into one file
+    static void write(const std::string& filename);
+
+private:
+    static int getThread();
+
+    static std::string toJson();
+
+};
+
+// traces its scope when tracer is active
+class TraceScope {
+private:
+    const char* _name;
+    int _peer;
+    bool _isActive;
+    std::chrono::steady_clock::time_point _start;
+
+public:
+    explicit TraceScope(const char* name, int peer = -1) : _name(name), _peer(peer), _isActive(Tracer::isActive()) {
+        if (_isActive) {
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (_isActive) {
+            Tracer::add(_name, _start, std::chrono::steady_clock::now(), _peer);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#endif //RGS_TRACER_H